@@ -24,7 +24,7 @@ int main(int argc [[maybe_unused]], char** argv [[maybe_unused]])
         for (int i = 0; /* forever */; ++i) {
             std::this_thread::sleep_for(666ms);
             spdlog::info("tick: {}", i);
-            sig("ping #" + std::to_string(i));
+            sig(rousette::http::makeEvent("ping #" + std::to_string(i)));
         }
     }};
 
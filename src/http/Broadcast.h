@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rousette::http {
+
+namespace impl {
+/** @short The part of a subscription which does not depend on the published type */
+struct Subscriber {
+    std::atomic<bool> connected{true};
+};
+
+class SubscriberList {
+public:
+    virtual ~SubscriberList() = default;
+    virtual void remove(const Subscriber* subscriber) = 0;
+};
+}
+
+/** @short A handle for disconnecting a subscriber; the subscriber stays connected when this goes away */
+class Connection {
+public:
+    Connection() = default;
+    Connection(std::weak_ptr<impl::SubscriberList> list, std::weak_ptr<impl::Subscriber> subscriber)
+        : m_list{std::move(list)}
+        , m_subscriber{std::move(subscriber)}
+    {
+    }
+
+    /** @short Stop the delivery. A publisher which has already started calling this subscriber might still finish that call. */
+    void disconnect()
+    {
+        auto subscriber = m_subscriber.lock();
+        if (!subscriber || !subscriber->connected.exchange(false)) {
+            return;
+        }
+        if (auto list = m_list.lock()) {
+            list->remove(subscriber.get());
+        }
+    }
+
+    bool connected() const
+    {
+        auto subscriber = m_subscriber.lock();
+        return subscriber && subscriber->connected;
+    }
+
+private:
+    std::weak_ptr<impl::SubscriberList> m_list;
+    std::weak_ptr<impl::Subscriber> m_subscriber;
+};
+
+/** @short A Connection which disconnects when it goes away */
+class ScopedConnection : public Connection {
+public:
+    ScopedConnection() = default;
+    ScopedConnection(Connection&& other)
+        : Connection{std::move(other)}
+    {
+    }
+    ScopedConnection(const ScopedConnection&) = delete;
+    ScopedConnection& operator=(const ScopedConnection&) = delete;
+    ScopedConnection& operator=(Connection&& other)
+    {
+        disconnect();
+        Connection::operator=(std::move(other));
+        return *this;
+    }
+    ~ScopedConnection()
+    {
+        disconnect();
+    }
+};
+
+/** @short Delivers values to a changing set of subscribers, RCU-style
+
+The list of subscribers is immutable. Connecting and disconnecting subscribers (which is rare) builds a new list under
+a mutex, and publishes it atomically. Publishing a value (which is frequent) just grabs the current list, without any
+mutex, so publishers contend neither with each other, nor with subscribers which come and go.
+
+A subscriber which is disconnected while a value is being published to it might still receive that value, just like
+with boost::signals2. Subscribers are called from the thread which publishes the value.
+*/
+template <typename... Args>
+class Broadcast {
+public:
+    using Slot = std::function<void(const Args&...)>;
+
+    Broadcast()
+        : m_list{std::make_shared<List>()}
+    {
+    }
+    Broadcast(const Broadcast&) = delete;
+    Broadcast& operator=(const Broadcast&) = delete;
+
+    Connection connect(Slot slot)
+    {
+        auto subscriber = std::make_shared<Subscriber>();
+        subscriber->slot = std::move(slot);
+        m_list->add(subscriber);
+        return Connection{m_list, subscriber};
+    }
+
+    void operator()(const Args&... args) const
+    {
+        auto subscribers = m_list->current();
+        for (const auto& subscriber : *subscribers) {
+            if (subscriber->connected.load(std::memory_order_acquire)) {
+                subscriber->slot(args...);
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return m_list->current()->size();
+    }
+
+private:
+    struct Subscriber : impl::Subscriber {
+        Slot slot;
+    };
+    using Subscribers = std::vector<std::shared_ptr<Subscriber>>;
+
+    class List : public impl::SubscriberList {
+    public:
+        std::shared_ptr<const Subscribers> current() const
+        {
+#if __cpp_lib_atomic_shared_ptr
+            return m_subscribers.load(std::memory_order_acquire);
+#else
+            return std::atomic_load_explicit(&m_subscribers, std::memory_order_acquire);
+#endif
+        }
+
+        void add(std::shared_ptr<Subscriber> subscriber)
+        {
+            std::lock_guard lock{m_mtx};
+            auto subscribers = std::make_shared<Subscribers>(*current());
+            subscribers->emplace_back(std::move(subscriber));
+            store(std::move(subscribers));
+        }
+
+        void remove(const impl::Subscriber* subscriber) override
+        {
+            std::lock_guard lock{m_mtx};
+            auto subscribers = std::make_shared<Subscribers>(*current());
+            std::erase_if(*subscribers, [subscriber](const auto& s) { return s.get() == subscriber; });
+            store(std::move(subscribers));
+        }
+
+    private:
+        std::mutex m_mtx; // serializes the writers, readers do not need it
+#if __cpp_lib_atomic_shared_ptr
+        std::atomic<std::shared_ptr<const Subscribers>> m_subscribers{std::make_shared<const Subscribers>()};
+#else
+        std::shared_ptr<const Subscribers> m_subscribers{std::make_shared<const Subscribers>()};
+#endif
+
+        void store(std::shared_ptr<const Subscribers> subscribers)
+        {
+#if __cpp_lib_atomic_shared_ptr
+            m_subscribers.store(std::move(subscribers), std::memory_order_release);
+#else
+            std::atomic_store_explicit(&m_subscribers, std::move(subscribers), std::memory_order_release);
+#endif
+        }
+    };
+
+    std::shared_ptr<List> m_list;
+};
+}
@@ -7,8 +7,6 @@
 
 #include <nghttp2/asio_http2_server.h>
 #include <nghttp2/nghttp2.h>
-#include <numeric>
-#include <regex>
 #include <spdlog/spdlog.h>
 #include "http/EventStream.h"
 #include "http/utils.hpp"
@@ -17,19 +15,87 @@ using namespace nghttp2::asio_http2;
 
 namespace rousette::http {
 
-/** @short After constructing, make sure to call activate() immediately. */
-EventStream::EventStream(const server::request& req, const server::response& res, Signal& signal, const std::optional<std::string>& initialEvent)
+namespace {
+/** @short Length-prefixed frames for clients which prefer them over text/event-stream */
+Framing preferredFraming(const header_map& headers)
+{
+    auto accept = getHeaderValue(headers, "accept");
+    if (!accept) {
+        return Framing::Sse;
+    }
+    for (const auto& mediaType : parseAcceptHeader(*accept)) {
+        if (mediaType == LENGTH_PREFIXED_FRAMES) {
+            return Framing::LengthPrefixed;
+        }
+        if (mediaType == "text/event-stream" || mediaType == "text/*" || mediaType == "*/*") {
+            return Framing::Sse;
+        }
+    }
+    return Framing::Sse;
+}
+
+/** @short Copy the framed event, starting at the offset, and report how many bytes fit into the buffer */
+std::size_t copyFrame(const Event& event, Framing framing, std::size_t offset, uint8_t* destination, std::size_t len)
+{
+    const auto& frame = event.frame(framing);
+    auto num = std::min(frame.size() - offset, len);
+    std::copy_n(frame.data() + offset, num, destination);
+    return num;
+}
+}
+
+/** @short After constructing, make sure to call activate() immediately. The signal is not listened to before that. */
+EventStream::EventStream(const server::request& req,
+                         const server::response& res,
+                         Signal& signal,
+                         const std::vector<EventPtr>& initialEvents,
+                         const DeliveryOptions& options)
     : res{res}
+    , source{signal}
+    , framing{preferredFraming(req.header())}
+    , queue{options.limits, framing}
     , peer{peer_from_request(req)}
+    , counters{options.counters ? options.counters : std::make_shared<StreamCounters>()}
+    , keepalive{options.keepalive}
+    , keepaliveTimer{res.io_service()}
+    , lastActivity{std::chrono::steady_clock::now()}
+    , lastProgress{lastActivity}
+    , batching{options.batching}
+    , batchTimer{res.io_service()}
+    , rateLimit{options.rateLimit}
+    , rateTimer{res.io_service()}
+    , gzip{acceptsEncoding(req.header(), "gzip") ? std::make_unique<GzipStream>() : nullptr}
 {
     spdlog::info("{}: {} {}", peer, req.method(), req.uri().raw_path);
 
-    if (initialEvent) {
-        enqueue(*initialEvent);
+    // these are not batched because there is no shared_ptr yet which the batch timer could refer to
+    {
+        std::lock_guard lock{mtx};
+        for (const auto& event : initialEvents) {
+            push(event);
+        }
+    }
+    if (!initialEvents.empty()) {
+        res.io_service().post([&res = this->res]() { res.resume(); });
     }
 
-    subscription = signal.connect([this](const auto& msg) {
-        enqueue(msg);
+}
+
+/** @short Start receiving events from the signal
+
+The slot only keeps a weak reference, so that a publisher which is still calling it after this stream has gone away does
+not touch a destroyed object. This is done by activate(), unless a subclass has to receive events even before that.
+*/
+void EventStream::subscribe()
+{
+    if (subscribed) {
+        return;
+    }
+    subscribed = true;
+    subscription = source.connect([weak = weak_from_this()](const auto& event) {
+        if (auto client = weak.lock()) {
+            client->enqueue(event);
+        }
     });
 }
 
@@ -41,40 +107,151 @@ shared_from_this() throws bad_weak_ptr, so we need a two-phase construction.
 void EventStream::activate()
 {
     auto client = shared_from_this();
-    res.write_head(200, {
-        {"content-type", {"text/event-stream", false}},
+    subscribe();
+    nghttp2::asio_http2::header_map headers{
+        {"content-type", {framing == Framing::LengthPrefixed ? LENGTH_PREFIXED_FRAMES : "text/event-stream", false}},
         {"access-control-allow-origin", {"*", false}},
-    });
+        {"vary", {"accept, accept-encoding", false}},
+    };
+    if (gzip) {
+        headers.emplace("content-encoding", nghttp2::asio_http2::header_value{"gzip", false});
+    }
+    res.write_head(200, std::move(headers));
+
+    ++counters->clients;
 
     res.on_close([client](const auto ec) {
         spdlog::debug("{}: closed ({})", client->peer, nghttp2_http2_strerror(ec));
         std::lock_guard lock{client->mtx};
         client->subscription.disconnect();
         client->state = Closed;
+        client->queue.clear();
+        client->compressed.clear();
+        client->compressedOffset = 0;
+        client->reportQueueDepth();
+        --client->counters->clients;
+        client->keepaliveTimer.cancel();
+        client->batch.clear();
+        client->batchTimer.cancel();
+        client->rateTimer.cancel();
     });
 
     res.end([client](uint8_t* destination, std::size_t len, uint32_t* data_flags) {
         return client->process(destination, len, data_flags);
     });
+
+    scheduleKeepalive();
+}
+
+/** @short Plan the next heartbeat or stall check. Only called from the I/O thread. */
+void EventStream::scheduleKeepalive()
+{
+    std::chrono::seconds interval{0};
+    for (const auto& period : {keepalive.heartbeat, keepalive.stallTimeout}) {
+        if (period.count() && (!interval.count() || period < interval)) {
+            interval = period;
+        }
+    }
+    if (!interval.count()) {
+        return;
+    }
+
+    keepaliveTimer.expires_after(interval);
+    keepaliveTimer.async_wait([weak = weak_from_this()](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (auto client = weak.lock()) {
+            client->onKeepaliveTimer();
+        }
+    });
+}
+
+void EventStream::onKeepaliveTimer()
+{
+    {
+        std::lock_guard lock{mtx};
+        if (state == Closed || state == Disconnecting) {
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (keepalive.stallTimeout.count() && hasPendingData() && now - lastProgress >= keepalive.stallTimeout) {
+            spdlog::warn("{}: client has not read anything for {}s, disconnecting", peer, keepalive.stallTimeout.count());
+            ++counters->reaped;
+            terminate(NGHTTP2_CANCEL);
+            return;
+        }
+
+        if (keepalive.heartbeat.count() && !hasPendingData() && now - lastActivity >= keepalive.heartbeat) {
+            spdlog::trace("{}: heartbeat", peer);
+            queue.push(Event::heartbeat());
+            reportQueueDepth();
+            lastActivity = now;
+            lastProgress = now;
+            state = HasEvents;
+            res.resume();
+        }
+    }
+
+    scheduleKeepalive();
+}
+
+/** @short Stop delivering events and close the stream. Expects the mutex to be held. */
+void EventStream::terminate(uint32_t errorCode)
+{
+    state = Disconnecting;
+    subscription.disconnect();
+    queue.clear();
+    compressed.clear();
+    compressedOffset = 0;
+    reportQueueDepth();
+    // the client is not reading anything, which means that the data generator is not being invoked either
+    res.io_service().post([weak = weak_from_this(), errorCode]() {
+        auto client = weak.lock();
+        if (!client) {
+            return;
+        }
+        {
+            std::lock_guard lock{client->mtx};
+            if (client->state != Disconnecting) {
+                return;
+            }
+        }
+        client->res.cancel(errorCode);
+    });
 }
 
 size_t EventStream::send_chunk(uint8_t* destination, std::size_t len, uint32_t* data_flags [[maybe_unused]])
 {
-    std::size_t written{0};
     if (state != HasEvents) throw std::logic_error{std::to_string(__LINE__)};
-    while (!queue.empty()) {
-        auto num = std::min(queue.front().size(), len - written);
-        std::copy_n(queue.front().begin(), num, destination + written);
-        written += num;
-        if (num < queue.front().size()) {
-            queue.front() = queue.front().substr(num);
-            // spdlog::trace("{}: send_chunk: partial write: {}", peer, num);
-            return written;
+    std::size_t written = 0;
+    if (gzip) {
+        // whole events are compressed only once they are about to be sent, so that the overflow policy can still drop them
+        while (written < len) {
+            if (compressedOffset == compressed.size()) {
+                if (queue.empty()) {
+                    break;
+                }
+                compressed = gzip->compress(queue.pop()->frame(framing));
+                compressedOffset = 0;
+            }
+            auto num = std::min(compressed.size() - compressedOffset, len - written);
+            std::copy_n(compressed.data() + compressedOffset, num, destination + written);
+            written += num;
+            compressedOffset += num;
         }
-        queue.pop_front();
-        spdlog::debug("{}: sent one event", peer);
+    } else {
+        written = queue.drain(destination, len);
+    }
+    if (written) {
+        lastActivity = lastProgress = std::chrono::steady_clock::now();
     }
-    state = WaitingForEvents;
+    if (!hasPendingData()) {
+        state = WaitingForEvents;
+    }
+    reportQueueDepth();
+    spdlog::trace("{}: send_chunk: {} bytes, {} bytes left", peer, written, queue.bytes());
     return written;
 }
 
@@ -87,36 +264,600 @@ ssize_t EventStream::process(uint8_t* destination, std::size_t len, uint32_t* da
     case WaitingForEvents:
         spdlog::trace("{}: sleeping", peer);
         return NGHTTP2_ERR_DEFERRED;
+    case Disconnecting:
+        return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
     case Closed:
         throw std::logic_error{"response already closed"};
     }
     __builtin_unreachable();
 }
 
-void EventStream::enqueue(const std::string& what)
+void EventStream::enqueue(const EventPtr& event)
 {
-    std::string buf;
-    buf.reserve(what.size());
-    const std::regex newline{"\n"};
-    for (auto it = std::sregex_token_iterator{what.begin(), what.end(), newline, -1};
-            it != std::sregex_token_iterator{}; ++it) {
-        buf += "data: ";
-        buf += *it;
-        buf += '\n';
+    std::lock_guard lock{mtx};
+    if (state == Closed || state == Disconnecting) {
+        spdlog::trace("{}: enqueue: already disconnected", peer);
+        return;
+    }
+
+    if (rateLimit && !withinRate()) {
+        return;
     }
-    buf += '\n';
 
+    if (batching) {
+        batch.push_back(event);
+        if (!batching->maxEvents || batch.size() < batching->maxEvents) {
+            if (batch.size() == 1) {
+                // the timer is only touched from the I/O thread, and it also wakes up the client, so that's a single post per batch
+                res.io_service().post([weak = weak_from_this(), window = batching->window]() {
+                    auto client = weak.lock();
+                    if (!client) {
+                        return;
+                    }
+                    client->batchTimer.expires_after(window);
+                    client->batchTimer.async_wait([weak](const boost::system::error_code& ec) {
+                        if (ec == boost::asio::error::operation_aborted) {
+                            return;
+                        }
+                        if (auto client = weak.lock()) {
+                            client->flushBatch();
+                        }
+                    });
+                });
+            }
+            return;
+        }
+        auto full = Event::batch(batch, *batching);
+        batch.clear();
+        if (!push(full)) {
+            return;
+        }
+    } else if (!push(event)) {
+        return;
+    }
+    res.io_service().post([&res = this->res]() { res.resume(); });
+}
+
+/** @short Send whatever has been collected in the current batch. Only called from the I/O thread. */
+void EventStream::flushBatch()
+{
     std::lock_guard lock{mtx};
-    if (state == Closed) {
-        spdlog::trace("{}: enqueue: already disconnected", peer);
+    if (state == Closed || state == Disconnecting || batch.empty()) {
         return;
     }
-    auto len = std::accumulate(queue.begin(), queue.end(), 0, [](const auto a, const auto b){
-            return a + b.size();
-            });
-    spdlog::trace("{}: new event, ∑ queue size = {}", peer, len);
-    queue.push_back(buf);
+    auto event = Event::batch(batch, *batching);
+    batch.clear();
+    if (push(event)) {
+        res.resume();
+    }
+}
+
+/** @short Check whether an event can be sent now, and take care of it if not. Expects the mutex to be held. */
+bool EventStream::withinRate()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (!resyncPending && !resyncing && now >= nextAllowed) {
+        nextAllowed = now + rateLimit->interval;
+        return true;
+    }
+
+    if (!rateLimit->latest) {
+        ++counters->droppedEvents;
+        return false;
+    }
+
+    // an ongoing resync plans the next one by itself
+    if (!resyncPending && !resyncing) {
+        res.io_service().post([weak = weak_from_this()]() {
+            if (auto client = weak.lock()) {
+                std::lock_guard lock{client->mtx};
+                client->scheduleResync();
+            }
+        });
+    }
+    resyncPending = true;
+    return false;
+}
+
+/** @short Replace the suppressed events once the rate allows that. Only called from the I/O thread, expects the mutex to be held. */
+void EventStream::scheduleResync()
+{
+    if (state == Closed || state == Disconnecting) {
+        return;
+    }
+    rateTimer.expires_at(nextAllowed);
+    rateTimer.async_wait([weak = weak_from_this()](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (auto client = weak.lock()) {
+            client->resync();
+        }
+    });
+}
+
+/** @short Send the latest state instead of all the events which were suppressed. Only called from the I/O thread. */
+void EventStream::resync()
+{
+    {
+        std::lock_guard lock{mtx};
+        if (state == Closed || state == Disconnecting || !resyncPending) {
+            return;
+        }
+        resyncPending = false;
+        resyncing = true;
+    }
+
+    // Not under the mutex; the callback might need locks which are held while the events are being produced.
+    // Events which arrive meanwhile are suppressed, and they will be covered by another resync.
+    auto events = rateLimit->latest();
+
+    std::lock_guard lock{mtx};
+    resyncing = false;
+    if (state == Closed || state == Disconnecting) {
+        return;
+    }
+    nextAllowed = std::chrono::steady_clock::now() + rateLimit->interval;
+    bool wakeup = false;
+    for (const auto& event : events) {
+        wakeup = push(event) || wakeup;
+        if (state == Disconnecting) {
+            return;
+        }
+    }
+    if (wakeup) {
+        res.resume();
+    }
+    if (resyncPending) {
+        scheduleResync();
+    }
+}
+
+/** @short Put an event into the queue, and report whether the client should be woken up. Expects the mutex to be held. */
+bool EventStream::push(const EventPtr& event)
+{
+    auto wasEmpty = !hasPendingData();
+    auto [dropped, disconnect] = queue.push(event);
+    if (disconnect) {
+        spdlog::warn("{}: client does not keep up with the events, disconnecting", peer);
+        ++counters->disconnects;
+        terminate(NGHTTP2_ENHANCE_YOUR_CALM);
+        return false;
+    }
+    lastActivity = std::chrono::steady_clock::now();
+    if (wasEmpty) {
+        // the client cannot be blamed for not reading while there was nothing to read
+        lastProgress = lastActivity;
+    }
+    if (dropped) {
+        spdlog::debug("{}: client does not keep up with the events, dropped {}", peer, dropped);
+        counters->droppedEvents += dropped;
+    }
+    reportQueueDepth();
+    spdlog::trace("{}: new event, ∑ queue size = {}", peer, queue.bytes());
     state = HasEvents;
-    res.io_service().post([&res = this->res]() { res.resume(); });
+    return true;
+}
+
+/** @short Whether there is something to send to the client. Expects the mutex to be held. */
+bool EventStream::hasPendingData() const
+{
+    return !queue.empty() || compressedOffset < compressed.size();
+}
+
+/** @short Propagate changes in the size of this client's queue to the stream-wide counters. Expects the mutex to be held. */
+void EventStream::reportQueueDepth()
+{
+    counters->queuedEvents += static_cast<int64_t>(queue.size()) - static_cast<int64_t>(reportedEvents);
+    counters->queuedBytes += static_cast<int64_t>(queue.bytes()) - static_cast<int64_t>(reportedBytes);
+    reportedEvents = queue.size();
+    reportedBytes = queue.bytes();
+}
+
+/** @short Wrap a message into a text/event-stream event, one `data:` field per line of the message, and an optional `id:` */
+std::string sseFrame(std::string_view message, const std::optional<uint64_t>& id)
+{
+    static constexpr std::string_view prefix{"data: "};
+
+    std::string buf;
+    buf.reserve(message.size() + prefix.size() + 2);
+    if (id) {
+        buf += "id: " + std::to_string(*id) + '\n';
+    }
+    std::size_t begin = 0;
+    while (begin < message.size()) {
+        auto end = message.find('\n', begin);
+        if (end == std::string_view::npos) {
+            end = message.size();
+        }
+        buf += prefix;
+        buf.append(message, begin, end - begin);
+        buf += '\n';
+        begin = end + 1;
+    }
+    buf += '\n';
+    return buf;
+}
+
+Event::Event(std::string_view message, const std::optional<uint64_t>& id)
+    : id{id}
+    , time{std::chrono::system_clock::now()}
+    , message{message}
+{
+}
+
+/** @short An event whose text/event-stream frame is not just the framed message */
+Event::Event(Framed, const std::optional<uint64_t>& id, const std::chrono::system_clock::time_point& time, std::string message, std::string sse)
+    : id{id}
+    , time{time}
+    , message{std::move(message)}
+{
+    std::call_once(m_framed[static_cast<std::size_t>(Framing::Sse)], [&]() { m_frames[static_cast<std::size_t>(Framing::Sse)] = std::move(sse); });
+}
+
+/** @short The event as it is sent on the wire
+ *
+ * Each framing is built on first use, and then shared by all clients, which only copy it into their send buffers (or
+ * compress it).
+ */
+const std::string& Event::frame(Framing framing) const
+{
+    auto index = static_cast<std::size_t>(framing);
+    std::call_once(m_framed[index], [this, framing, &buf = m_frames[index]]() {
+        if (framing == Framing::Sse) {
+            buf = sseFrame(message, id);
+            return;
+        }
+        auto header = binaryHeader();
+        buf.reserve(header.size() + message.size());
+        buf.append(header.begin(), header.end());
+        buf += message;
+    });
+    return m_frames[index];
+}
+
+/** @short Header of the length-prefixed frame of this event
+
+All fields are big-endian:
+- 4 bytes: length of the message which follows the header
+- 1 byte: flags; bit 0 is set when the event has an ID
+- 3 bytes: reserved, zero
+- 8 bytes: ID of the event, zero when it has none
+- 8 bytes: when the event was created, in microseconds since the Unix epoch; zero for heartbeats
+*/
+std::array<uint8_t, Event::BinaryHeaderSize> Event::binaryHeader() const
+{
+    std::array<uint8_t, BinaryHeaderSize> res{};
+    auto put = [&res](std::size_t offset, std::size_t bytes, uint64_t value) {
+        for (std::size_t i = 0; i < bytes; ++i) {
+            res[offset + i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+        }
+    };
+    put(0, 4, message.size());
+    res[4] = id ? 0x01 : 0x00;
+    put(8, 8, id.value_or(0));
+    put(16, 8, std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count());
+    return res;
+}
+
+/** @short Number of bytes which are sent for this event */
+std::size_t Event::size(Framing framing) const
+{
+    return framing == Framing::Sse ? frame(Framing::Sse).size() : BinaryHeaderSize + message.size();
+}
+
+/** @short An SSE comment, or a frame without any message, which is ignored by the clients */
+EventPtr Event::heartbeat()
+{
+    static const EventPtr event{new Event{Framed{}, std::nullopt, {}, {}, ":\n\n"}};
+    return event;
+}
+
+namespace {
+/** @short The `data:` lines of a framed event, i.e., without the `id:` line and without the terminating empty line */
+std::string_view dataLines(const std::string& frame)
+{
+    std::string_view res{frame};
+    if (res.starts_with("id: ")) {
+        res.remove_prefix(res.find('\n') + 1);
+    }
+    res.remove_suffix(1);
+    return res;
+}
+}
+
+/** @short Join several events into a single one, so that the client receives (and parses) just one message
+
+The text/event-stream frames of the individual events are shared with other clients, so their lines are copied into a
+frame which is enclosed in the prefix and the suffix of the batch. The batch carries the ID of its last event, which is all that a
+client needs for resuming.
+*/
+EventPtr Event::batch(const std::vector<EventPtr>& events, const Batching& batching)
+{
+    const auto prefix = sseFrame(batching.prefix);
+    const auto separator = sseFrame(batching.separator);
+    const auto suffix = sseFrame(batching.suffix);
+    std::optional<uint64_t> id;
+    std::chrono::system_clock::time_point time;
+    std::size_t size = prefix.size() + suffix.size() + 32;
+    std::size_t messageSize = batching.prefix.size() + batching.suffix.size();
+    for (const auto& event : events) {
+        size += event->frame(Framing::Sse).size() + separator.size();
+        messageSize += event->message.size() + batching.separator.size();
+        if (event->id) {
+            id = event->id;
+        }
+        time = event->time;
+    }
+
+    std::string message;
+    message.reserve(messageSize);
+    message += batching.prefix;
+    for (auto it = events.begin(); it != events.end(); ++it) {
+        if (it != events.begin()) {
+            message += batching.separator;
+        }
+        message += (*it)->message;
+    }
+    message += batching.suffix;
+
+    std::string frame;
+    frame.reserve(size);
+    if (id) {
+        frame += "id: " + std::to_string(*id) + '\n';
+    }
+    frame += dataLines(prefix);
+    for (auto it = events.begin(); it != events.end(); ++it) {
+        if (it != events.begin()) {
+            frame += dataLines(separator);
+        }
+        frame += dataLines((*it)->frame(Framing::Sse));
+    }
+    frame += dataLines(suffix);
+    frame += '\n';
+    return EventPtr{new Event{Framed{}, id, time, std::move(message), std::move(frame)}};
+}
+
+EventPtr makeEvent(std::string_view message, const std::optional<uint64_t>& id)
+{
+    return std::make_shared<const Event>(message, id);
+}
+
+/** @short The IDs start right after @p lastId, so that histories with distinct starting points never share an ID */
+EventHistory::EventHistory(std::size_t capacity, uint64_t lastId)
+    : m_capacity{capacity}
+    , m_lastId{lastId}
+{
+}
+
+/** @short Creates an event with the next ID, and remembers it */
+EventPtr EventHistory::push(std::string_view message)
+{
+    auto event = makeEvent(message, ++m_lastId);
+    if (m_capacity) {
+        if (m_events.size() == m_capacity) {
+            m_events.pop_front();
+        }
+        m_events.push_back(event);
+    }
+    return event;
+}
+
+/** @short Account for an event which nobody got; nobody can resume after it, or after any earlier event */
+void EventHistory::skip()
+{
+    ++m_lastId;
+    m_events.clear();
+}
+
+/** @short Forget all events, e.g., because the next one supersedes them. The IDs keep increasing. */
+void EventHistory::clear()
+{
+    m_events.clear();
+}
+
+/** @short Forget all events, and continue with the IDs which come after @p lastId */
+void EventHistory::restart(uint64_t lastId)
+{
+    m_events.clear();
+    m_lastId = lastId;
+}
+
+/** @short ID of the most recent event, zero if there was none */
+uint64_t EventHistory::lastId() const
+{
+    return m_lastId;
+}
+
+/** @short Events which came after the one with the given ID, or nullopt if some of them are not remembered anymore */
+std::optional<std::vector<EventPtr>> EventHistory::after(uint64_t id) const
+{
+    if (id > m_lastId || (id < m_lastId && (m_events.empty() || id + 1 < *m_events.front()->id))) {
+        return std::nullopt;
+    }
+
+    std::vector<EventPtr> res;
+    for (const auto& event : m_events) {
+        if (*event->id > id) {
+            res.push_back(event);
+        }
+    }
+    return res;
+}
+
+EventQueue::EventQueue(const QueueLimits& limits, Framing framing)
+    : m_limits{limits}
+    , m_framing{framing}
+{
+}
+
+EventQueue::PushResult EventQueue::push(EventPtr event)
+{
+    m_bytes += event->size(m_framing);
+    m_events.push_back(std::move(event));
+
+    PushResult res;
+    if (!overLimit()) {
+        return res;
+    }
+
+    switch (m_limits.policy) {
+    case OverflowPolicy::Disconnect:
+        res.disconnect = true;
+        break;
+    case OverflowPolicy::DropOldest:
+        while (overLimit() && dropOldest()) {
+            ++res.dropped;
+        }
+        break;
+    case OverflowPolicy::CoalesceLatest:
+        while (dropOldest()) {
+            ++res.dropped;
+        }
+        break;
+    }
+    return res;
+}
+
+/** @short Remove the oldest event from the queue. It must not have been partially drained. */
+EventPtr EventQueue::pop()
+{
+    auto event = std::move(m_events.front());
+    m_events.pop_front();
+    m_bytes -= event->size(m_framing);
+    return event;
+}
+
+/** @short Copy as much of the queued data as fits into the buffer, and remove them from the queue
+
+An event which does not fit stays in the queue, and the next call continues where this one stopped.
+*/
+std::size_t EventQueue::drain(uint8_t* destination, std::size_t len)
+{
+    std::size_t written = 0;
+    while (!m_events.empty() && written < len) {
+        const auto& front = *m_events.front();
+        auto num = copyFrame(front, m_framing, m_offset, destination + written, len - written);
+        written += num;
+        m_offset += num;
+        if (m_offset == front.size(m_framing)) {
+            m_events.pop_front();
+            m_offset = 0;
+        }
+    }
+    m_bytes -= written;
+    return written;
+}
+
+void EventQueue::clear()
+{
+    m_events.clear();
+    m_offset = 0;
+    m_bytes = 0;
+}
+
+bool EventQueue::overLimit() const
+{
+    if (m_events.size() < 2) {
+        return false;
+    }
+    return (m_limits.maxEvents && m_events.size() > m_limits.maxEvents) || (m_limits.maxBytes && m_bytes > m_limits.maxBytes);
+}
+
+/** @short Remove the oldest event which is neither the latest one, nor partially sent already */
+bool EventQueue::dropOldest()
+{
+    auto it = m_offset ? m_events.begin() + 1 : m_events.begin();
+    if (it == m_events.end() || it + 1 == m_events.end()) {
+        return false;
+    }
+    m_bytes -= (*it)->size(m_framing);
+    m_events.erase(it);
+    return true;
+}
+
+bool EventQueue::empty() const
+{
+    return m_events.empty();
+}
+
+/** @short Number of events which have not been completely sent yet */
+std::size_t EventQueue::size() const
+{
+    return m_events.size();
+}
+
+std::size_t EventQueue::bytes() const
+{
+    return m_bytes;
+}
+
+std::shared_ptr<StreamCounters> StreamStatistics::counters(const std::string& stream)
+{
+    std::lock_guard lock{m_mtx};
+    auto& ptr = m_streams[stream];
+    if (!ptr) {
+        ptr = std::make_shared<StreamCounters>();
+    }
+    return ptr;
+}
+
+namespace {
+/** @short A JSON string literal, including the quotes (RFC 8259, sec. 7) */
+std::string jsonString(std::string_view str)
+{
+    std::string res = "\"";
+    for (const auto c : str) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+            res += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            res += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+        } else {
+            res += c;
+        }
+    }
+    return res + '"';
+}
+
+/** @short Replay counters of a stream, if it has any replays at all; the durations are averaged */
+std::string replaysAsJSON(const StreamCounters& c)
+{
+    auto memory = c.memoryReplays.load();
+    auto stored = c.storedReplays.load();
+    if (!memory && !stored) {
+        return {};
+    }
+    return fmt::format(R"(,
+      "replays": {{
+        "from-memory": {},
+        "from-memory-average-us": {},
+        "from-storage": {},
+        "from-storage-average-us": {}
+      }})",
+                       memory, memory ? c.memoryReplayMicroseconds.load() / memory : 0, stored, stored ? c.storedReplayMicroseconds.load() / stored : 0);
+}
+}
+
+std::string StreamStatistics::asJSON() const
+{
+    std::lock_guard lock{m_mtx};
+    std::string res = "{\n  \"event-streams\": {";
+    bool first = true;
+    for (const auto& [name, c] : m_streams) {
+        res += fmt::format(R"({}
+    {}: {{
+      "clients": {},
+      "queued-events": {},
+      "queued-bytes": {},
+      "dropped-events": {},
+      "disconnects": {},
+      "reaped": {}{}
+    }})",
+                           first ? "" : ",", jsonString(name), c->clients.load(), c->queuedEvents.load(), c->queuedBytes.load(), c->droppedEvents.load(), c->disconnects.load(), c->reaped.load(), replaysAsJSON(*c));
+        first = false;
+    }
+    res += first ? "}\n}\n" : "\n  }\n}\n";
+    return res;
 }
 }
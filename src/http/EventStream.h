@@ -7,11 +7,21 @@
 
 #pragma once
 
-#include <boost/signals2.hpp>
-#include <list>
+#include <array>
+#include <atomic>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <spdlog/spdlog.h>
+#include <string_view>
+#include <vector>
+#include "http/Broadcast.h"
+#include "http/Gzip.h"
 
 namespace nghttp2::asio_http2::server {
 class request;
@@ -21,33 +31,258 @@ class response;
 /** @short HTTP bits */
 namespace rousette::http {
 
+std::string sseFrame(std::string_view message, const std::optional<uint64_t>& id = std::nullopt);
+
+/** @short Delivery of several events in a single text/event-stream message, see Event::batch() */
+struct Batching {
+    /** @short A batch is sent once it has this many events; 0 for no limit */
+    std::size_t maxEvents = 0;
+    /** @short A batch is sent at most this long after its first event has arrived */
+    std::chrono::milliseconds window{100};
+    /** @short The batched message is the prefix, the individual messages delimited by the separator, and the suffix */
+    std::string prefix;
+    std::string separator;
+    std::string suffix;
+};
+
+/** @short How the events are delimited on the wire */
+enum class Framing {
+    Sse, ///< text/event-stream
+    LengthPrefixed, ///< A fixed header and the message as-is, see Event::binaryHeader()
+};
+
+/** @short Media type of the length-prefixed framing, which a client can ask for via the Accept header */
+constexpr auto LENGTH_PREFIXED_FRAMES = "application/vnd.rousette.event-frames";
+
+/** @short An event which is framed just once per framing, and then shared by all clients which receive it */
+struct Event {
+    static constexpr std::size_t BinaryHeaderSize = 24;
+
+    explicit Event(std::string_view message, const std::optional<uint64_t>& id = std::nullopt);
+    /** @short Clients which reconnect send this back in the Last-Event-ID header */
+    const std::optional<uint64_t> id;
+    /** @short When the event was created */
+    const std::chrono::system_clock::time_point time;
+    /** @short The payload, as sent in the length-prefixed frames */
+    const std::string message;
+
+    const std::string& frame(Framing framing) const;
+    std::array<uint8_t, BinaryHeaderSize> binaryHeader() const;
+    std::size_t size(Framing framing) const;
+
+    static std::shared_ptr<const Event> heartbeat();
+    static std::shared_ptr<const Event> batch(const std::vector<std::shared_ptr<const Event>>& events, const Batching& batching);
+
+private:
+    struct Framed {
+    };
+    Event(Framed, const std::optional<uint64_t>& id, const std::chrono::system_clock::time_point& time, std::string message, std::string sse);
+
+    /** @short Frames are only built once some client actually needs them, see frame() */
+    mutable std::array<std::once_flag, 2> m_framed;
+    mutable std::array<std::string, 2> m_frames;
+};
+using EventPtr = std::shared_ptr<const Event>;
+
+EventPtr makeEvent(std::string_view message, const std::optional<uint64_t>& id = std::nullopt);
+
+/** @short At most one event per interval for a single client, regardless of how often they are produced */
+struct RateLimit {
+    std::chrono::microseconds interval;
+    /** @short If set, the suppressed events are replaced by whatever this returns once the interval has passed,
+     * e.g., by a snapshot of the current state. Otherwise, the suppressed events are dropped. */
+    std::function<std::vector<EventPtr>()> latest;
+};
+
+/** @short Recent events with increasing IDs, so that a client which reconnects gets just the events it has missed
+
+Not thread-safe, the caller is responsible for locking.
+*/
+class EventHistory {
+public:
+    explicit EventHistory(std::size_t capacity, uint64_t lastId = 0);
+    EventPtr push(std::string_view message);
+    void skip();
+    void clear();
+    void restart(uint64_t lastId);
+    uint64_t lastId() const;
+    std::optional<std::vector<EventPtr>> after(uint64_t id) const;
+
+private:
+    std::size_t m_capacity;
+    std::deque<EventPtr> m_events;
+    uint64_t m_lastId = 0;
+};
+
+/** @short What to do when a client does not keep up with the events */
+enum class OverflowPolicy {
+    DropOldest, ///< Discard the oldest events which have not been sent yet
+    CoalesceLatest, ///< Discard everything which has not been sent yet except for the latest event
+    Disconnect, ///< Terminate the stream
+};
+
+/** @short Limits of the data queued for a single client; zero means "no limit" */
+struct QueueLimits {
+    std::size_t maxEvents = 0;
+    std::size_t maxBytes = 0;
+    OverflowPolicy policy = OverflowPolicy::DropOldest;
+};
+
+/** @short Detection of clients which are gone without closing the connection; zero disables each of these */
+struct Keepalive {
+    /** @short Send an SSE comment when the stream has been idle for this long, so that a dead peer shows up in TCP */
+    std::chrono::seconds heartbeat{0};
+    /** @short Disconnect a client which has not read anything for this long while there was something to send */
+    std::chrono::seconds stallTimeout{0};
+};
+
+/** @short FIFO of shared events which are delivered in arbitrarily sized chunks
+
+The latest event is always accepted, no matter the limits. An event which has already been partially sent is never dropped.
+Not thread-safe, the caller is responsible for locking.
+*/
+class EventQueue {
+public:
+    struct PushResult {
+        std::size_t dropped = 0;
+        bool disconnect = false;
+    };
+
+    explicit EventQueue(const QueueLimits& limits = {}, Framing framing = Framing::Sse);
+    PushResult push(EventPtr event);
+    EventPtr pop();
+    std::size_t drain(uint8_t* destination, std::size_t len);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+    std::size_t bytes() const;
+
+private:
+    QueueLimits m_limits;
+    Framing m_framing;
+    std::deque<EventPtr> m_events;
+    /** @short How many bytes of the first event have already been sent */
+    std::size_t m_offset = 0;
+    /** @short Number of bytes in the whole queue which have not been sent yet */
+    std::size_t m_bytes = 0;
+
+    bool overLimit() const;
+    bool dropOldest();
+};
+
+/** @short Runtime statistics of one kind of event streams, shared by all of its clients */
+struct StreamCounters {
+    std::atomic<int64_t> clients{0};
+    std::atomic<int64_t> queuedEvents{0};
+    std::atomic<int64_t> queuedBytes{0};
+    std::atomic<uint64_t> droppedEvents{0};
+    std::atomic<uint64_t> disconnects{0};
+    /** @short Clients which were disconnected because they stopped reading */
+    std::atomic<uint64_t> reaped{0};
+    /** @short Replays served from the memory, and their total duration */
+    std::atomic<uint64_t> memoryReplays{0};
+    std::atomic<uint64_t> memoryReplayMicroseconds{0};
+    /** @short Replays which had to go to the persistent storage, and their total duration */
+    std::atomic<uint64_t> storedReplays{0};
+    std::atomic<uint64_t> storedReplayMicroseconds{0};
+};
+
+/** @short Registry of StreamCounters, indexed by the stream name */
+class StreamStatistics {
+public:
+    std::shared_ptr<StreamCounters> counters(const std::string& stream);
+    std::string asJSON() const;
+
+private:
+    mutable std::mutex m_mtx;
+    std::map<std::string, std::shared_ptr<StreamCounters>> m_streams;
+};
+
+/** @short How the events are delivered to a single client of an EventStream */
+struct DeliveryOptions {
+    QueueLimits limits;
+    /** @short Statistics of the kind of streams which this client belongs to; the client counts just for itself if not set */
+    std::shared_ptr<StreamCounters> counters;
+    Keepalive keepalive;
+    std::optional<Batching> batching;
+    std::optional<RateLimit> rateLimit;
+};
+
 /** @short Event delivery via text/event-stream
 
 Recieve data from a Signal, and deliver them to an HTTP client via a text/event-stream streamed response.
+Clients which prefer LENGTH_PREFIXED_FRAMES in their Accept header get those instead of text/event-stream.
 */
 class EventStream : public std::enable_shared_from_this<EventStream> {
 public:
-    using Signal = boost::signals2::signal<void(const std::string& message)>;
+    using Signal = Broadcast<EventPtr>;
 
-    EventStream(const nghttp2::asio_http2::server::request& req, const nghttp2::asio_http2::server::response& res, Signal& signal, const std::optional<std::string>& initialEvent = std::nullopt);
+    EventStream(const nghttp2::asio_http2::server::request& req,
+                const nghttp2::asio_http2::server::response& res,
+                Signal& signal,
+                const std::vector<EventPtr>& initialEvents = {},
+                const DeliveryOptions& options = {});
     void activate();
 
+protected:
+    void subscribe();
+
 private:
     const nghttp2::asio_http2::server::response& res;
+    Signal& source;
+    bool subscribed = false;
     enum State {
         HasEvents,
         WaitingForEvents,
+        Disconnecting,
         Closed,
     };
 
     State state = WaitingForEvents;
-    std::list<std::string> queue;
-    mutable std::mutex mtx; // for `state` and `queue`
-    boost::signals2::scoped_connection subscription;
+    const Framing framing;
+    EventQueue queue;
+    mutable std::mutex mtx; // for `state`, `queue`, `batch`, the rate limiting, the compressed data and the reported queue depth
+    ScopedConnection subscription;
     const std::string peer;
+    std::shared_ptr<StreamCounters> counters;
+    std::size_t reportedEvents = 0;
+    std::size_t reportedBytes = 0;
+    const Keepalive keepalive;
+    boost::asio::steady_timer keepaliveTimer;
+    /** @short When something was last enqueued or sent */
+    std::chrono::steady_clock::time_point lastActivity;
+    /** @short When the client has last read something, or when it has got something to read after an idle period */
+    std::chrono::steady_clock::time_point lastProgress;
+    const std::optional<Batching> batching;
+    /** @short Events which were received, but which wait for the rest of their batch */
+    std::vector<EventPtr> batch;
+    boost::asio::steady_timer batchTimer;
+    const std::optional<RateLimit> rateLimit;
+    /** @short When the next event can be sent without exceeding the rate limit */
+    std::chrono::steady_clock::time_point nextAllowed;
+    /** @short Some events were suppressed, and they will be replaced by RateLimit::latest */
+    bool resyncPending = false;
+    /** @short RateLimit::latest is being invoked */
+    bool resyncing = false;
+    boost::asio::steady_timer rateTimer;
+    /** @short Compression of the whole response, if the client supports that */
+    std::unique_ptr<GzipStream> gzip;
+    /** @short Compressed data which have not been sent yet */
+    std::string compressed;
+    std::size_t compressedOffset = 0;
 
+    void reportQueueDepth();
+    bool hasPendingData() const;
+    bool push(const EventPtr& event);
+    void flushBatch();
+    bool withinRate();
+    void scheduleResync();
+    void resync();
+    void scheduleKeepalive();
+    void onKeepaliveTimer();
+    void terminate(uint32_t errorCode);
     size_t send_chunk(uint8_t* destination, std::size_t len, uint32_t* data_flags);
     ssize_t process(uint8_t* destination, std::size_t len, uint32_t* data_flags);
-    void enqueue(const std::string& what);
+    void enqueue(const EventPtr& event);
 };
 }
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include <stdexcept>
+#include <zlib.h>
+#include "http/Gzip.h"
+
+namespace rousette::http {
+
+GzipStream::GzipStream()
+    : m_stream{std::make_unique<z_stream>()}
+{
+    // 15 bits of window, plus 16 for a gzip header and trailer instead of the zlib ones
+    if (deflateInit2(m_stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error{"deflateInit2 failed"};
+    }
+}
+
+GzipStream::~GzipStream()
+{
+    deflateEnd(m_stream.get());
+}
+
+/** @short Compress another piece of data, and flush everything that has been compressed so far */
+std::string GzipStream::compress(std::string_view data)
+{
+    std::string res;
+    res.resize(deflateBound(m_stream.get(), data.size()) + 16);
+
+    m_stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    m_stream->avail_in = data.size();
+    std::size_t written = 0;
+    do {
+        if (written == res.size()) {
+            res.resize(res.size() * 2);
+        }
+        m_stream->next_out = reinterpret_cast<Bytef*>(res.data() + written);
+        m_stream->avail_out = res.size() - written;
+        if (auto ret = deflate(m_stream.get(), Z_SYNC_FLUSH); ret != Z_OK && ret != Z_BUF_ERROR) {
+            throw std::runtime_error{"deflate failed"};
+        }
+        written = res.size() - m_stream->avail_out;
+    } while (m_stream->avail_out == 0);
+
+    res.resize(written);
+    return res;
+}
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+typedef struct z_stream_s z_stream;
+
+namespace rousette::http {
+
+/** @short A gzip stream which is compressed piece by piece
+
+Each piece is flushed, so that the client can decompress everything it has received so far, without waiting for more
+data. The compression state carries over from one piece to the next one, which is what makes repetitive data (such as
+the envelopes of notifications) compress well.
+*/
+class GzipStream {
+public:
+    GzipStream();
+    ~GzipStream();
+    GzipStream(const GzipStream&) = delete;
+    GzipStream& operator=(const GzipStream&) = delete;
+
+    std::string compress(std::string_view data);
+
+private:
+    std::unique_ptr<z_stream> m_stream;
+};
+}
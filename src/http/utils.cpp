@@ -9,6 +9,8 @@
 #include <boost/fusion/adapted/struct/adapt_struct.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/spirit/home/x3.hpp>
+#include <algorithm>
+#include <cctype>
 #include "http/utils.hpp"
 
 namespace {
@@ -185,4 +187,70 @@ std::optional<std::string> parseUrlPrefix(const nghttp2::asio_http2::header_map&
 
     return std::nullopt;
 }
+
+/** @short ID of the last event which a reconnecting text/event-stream client has seen, if it is a valid one */
+std::optional<uint64_t> lastEventId(const nghttp2::asio_http2::header_map& headers)
+{
+    auto value = getHeaderValue(headers, "last-event-id");
+    if (!value || value->empty() || !std::ranges::all_of(*value, [](unsigned char c) { return std::isdigit(c); })) {
+        return std::nullopt;
+    }
+
+    try {
+        return std::stoull(*value);
+    } catch (const std::out_of_range&) {
+        return std::nullopt;
+    }
+}
+
+/** @short Whether the client accepts a content coding, according to the Accept-Encoding header (RFC 9110, section 12.5.3) */
+bool acceptsEncoding(const nghttp2::asio_http2::header_map& headers, const std::string& coding)
+{
+    auto value = getHeaderValue(headers, "accept-encoding");
+    if (!value) {
+        return false;
+    }
+
+    auto trim = [](std::string_view str) {
+        while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+            str.remove_prefix(1);
+        }
+        while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back()))) {
+            str.remove_suffix(1);
+        }
+        return str;
+    };
+    auto lower = [](std::string_view str) {
+        std::string res{str};
+        std::transform(res.begin(), res.end(), res.begin(), ::tolower);
+        return res;
+    };
+
+    std::optional<bool> wildcard;
+    std::string_view rest{*value};
+    while (!rest.empty()) {
+        auto item = rest.substr(0, rest.find(','));
+        rest.remove_prefix(std::min(item.size() + 1, rest.size()));
+
+        auto name = lower(trim(item.substr(0, item.find(';'))));
+        bool acceptable = true;
+        if (auto semicolon = item.find(';'); semicolon != std::string_view::npos) {
+            auto param = trim(item.substr(semicolon + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                try {
+                    acceptable = std::stod(std::string{param.substr(2)}) > 0;
+                } catch (const std::logic_error&) {
+                    return false;
+                }
+            }
+        }
+
+        if (name == coding) {
+            return acceptable;
+        } else if (name == "*") {
+            wildcard = acceptable;
+        }
+    }
+    return wildcard.value_or(false);
+}
 }
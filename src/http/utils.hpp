@@ -22,4 +22,6 @@ std::vector<std::string> parseAcceptHeader(const std::string& headerValue);
 ProtoAndHost parseForwardedHeader(const std::string& headerValue);
 std::optional<std::string> parseUrlPrefix(const nghttp2::asio_http2::header_map& headers);
 std::optional<std::string> getHeaderValue(const nghttp2::asio_http2::header_map& headers, const std::string& header);
+std::optional<uint64_t> lastEventId(const nghttp2::asio_http2::header_map& headers);
+bool acceptsEncoding(const nghttp2::asio_http2::header_map& headers, const std::string& coding);
 }
@@ -5,7 +5,11 @@
  *
  */
 
+#include <algorithm>
+#include <cctype>
+#include <random>
 #include <libyang-cpp/Time.hpp>
+#include <spdlog/spdlog.h>
 #include <sysrepo-cpp/Connection.hpp>
 #include <sysrepo-cpp/Subscription.hpp>
 #include <sysrepo-cpp/utils/exception.hpp>
@@ -59,131 +63,728 @@ void subscribe(
     std::optional<sysrepo::Subscription>& sub,
     sysrepo::Session& session,
     const std::string& moduleName,
-    rousette::http::EventStream::Signal& signal,
-    libyang::DataFormat dataFormat,
+    const sysrepo::NotifCb& notifCb,
     const std::optional<std::string>& filter,
     const std::optional<sysrepo::NotificationTimeStamp>& startTime,
     const std::optional<sysrepo::NotificationTimeStamp>& stopTime)
 {
-    auto notifCb = [&signal, dataFormat](auto session, auto, sysrepo::NotificationType type, const std::optional<libyang::DataNode>& notificationTree, const sysrepo::NotificationTimeStamp& time) {
-        if (type != sysrepo::NotificationType::Realtime && type != sysrepo::NotificationType::Replay) {
-            return;
-        }
-
-        signal(as_restconf_notification(session.getContext(), dataFormat, *notificationTree, time));
-    };
-
     if (!sub) {
-        sub = session.onNotification(moduleName, std::move(notifCb), filter, startTime, stopTime);
+        sub = session.onNotification(moduleName, notifCb, filter, startTime, stopTime);
     } else {
-        sub->onNotification(moduleName, std::move(notifCb), filter, startTime, stopTime);
+        sub->onNotification(moduleName, notifCb, filter, startTime, stopTime);
     }
 }
 
-/** @brief Early filter for modules that can be subscribed to. This returns true for module without any notification node, but sysrepo will throw when subscribing */
+/** @brief Early filter for modules that can be subscribed to. */
 bool canBeSubscribed(const libyang::Module& mod)
 {
     return mod.implemented() && mod.name() != "sysrepo";
 }
+
+void collectNotificationModules(const libyang::SchemaNode& node, std::set<std::string>& res)
+{
+    switch (node.nodeType()) {
+    case libyang::NodeType::Notification:
+        // nodes from augments belong to the augmenting module, which is also the module to subscribe to
+        res.insert(node.module().name());
+        break;
+    case libyang::NodeType::Container:
+    case libyang::NodeType::List:
+        for (const auto& child : node.childInstantiables()) {
+            collectNotificationModules(child, res);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/** @brief Subscribes to notifications from all modules which define any
+ *
+ * @return The number of modules which were actually subscribed to
+ */
+std::size_t subscribeAll(
+    std::optional<sysrepo::Subscription>& sub,
+    sysrepo::Session& session,
+    const std::set<std::string>& modules,
+    const sysrepo::NotifCb& notifCb,
+    const std::optional<std::string>& filter,
+    const std::optional<sysrepo::NotificationTimeStamp>& startTime,
+    const std::optional<sysrepo::NotificationTimeStamp>& stopTime)
+{
+    std::size_t subscribed = 0;
+    for (const auto& mod : modules) {
+        try {
+            subscribe(sub, session, mod, notifCb, filter, startTime, stopTime);
+            ++subscribed;
+        } catch (sysrepo::ErrorWithCode& e) {
+            if (e.code() == sysrepo::ErrorCode::InvalidArgument) {
+                throw rousette::restconf::ErrorResponse(400, "application", "invalid-argument", e.what());
+            }
+
+            // sysrepo throws NotFound when the filter does not select any notification from this particular module
+            if (e.code() != sysrepo::ErrorCode::NotFound) {
+                throw;
+            }
+        }
+    }
+    return subscribed;
+}
+
+/** @brief Is the notification meant for the client? Unlike NotificationDispatcher::dispatch(), this one does not cache anything. */
+bool accepts(const rousette::restconf::NotificationDispatcher::Client& client, const libyang::DataNode& notification)
+{
+    if (client.modules && !client.modules->contains(std::string{notification.schema().module().name()})) {
+        return false;
+    }
+    if (!client.session.checkNacmOperation(notification)) {
+        return false;
+    }
+
+    auto root = notification;
+    while (root.parent()) {
+        root = *root.parent();
+    }
+    return std::ranges::all_of(client.filters, [&](const auto& filter) { return !root.findXPath(filter).empty(); });
+}
+
+auto microsecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** @brief Batched notifications are a JSON array, or a sequence of XML elements within a wrapper element */
+rousette::http::DeliveryOptions withBatchEnvelope(rousette::http::DeliveryOptions options, libyang::DataFormat dataFormat)
+{
+    auto& batching = options.batching;
+    if (!batching) {
+        return options;
+    }
+    if (dataFormat == libyang::DataFormat::JSON) {
+        batching->prefix = "[";
+        batching->separator = ",";
+        batching->suffix = "]";
+    } else {
+        batching->prefix = "<notifications>";
+        batching->separator = "";
+        batching->suffix = "</notifications>";
+    }
+    return options;
+}
 }
 
 namespace rousette::restconf {
 
+/** @brief Names of all modules which define at least one notification, including notifications nested in containers and lists */
+std::set<std::string> notificationModules(const libyang::Context& ctx)
+{
+    std::set<std::string> res;
+    for (const auto& mod : ctx.modules()) {
+        if (!canBeSubscribed(mod)) {
+            continue;
+        }
+        for (const auto& node : mod.childInstantiables()) {
+            collectNotificationModules(node, res);
+        }
+    }
+    return res;
+}
+
+NotificationReplayBuffer::NotificationReplayBuffer(std::size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+NotificationReplayBuffer::Entry::Entry(uint64_t id, const sysrepo::NotificationTimeStamp& time, libyang::DataNode notification)
+    : id(id)
+    , time(time)
+    , notification(std::move(notification))
+{
+}
+
+rousette::http::EventPtr NotificationReplayBuffer::Entry::event(const libyang::Context& ctx, libyang::DataFormat dataFormat) const
+{
+    auto& event = m_events[dataFormat];
+    if (!event) {
+        event = rousette::http::makeEvent(as_restconf_notification(ctx, dataFormat, notification, time), id);
+    }
+    return event;
+}
+
+std::size_t NotificationReplayBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+/** @brief From now on, all notifications from these modules are pushed into the buffer */
+void NotificationReplayBuffer::startRecording(const std::set<std::string>& modules, const sysrepo::NotificationTimeStamp& since, uint64_t firstId)
+{
+    for (const auto& mod : modules) {
+        m_recordings.try_emplace(mod, Recording{since, firstId});
+    }
+}
+
+void NotificationReplayBuffer::push(Entry entry)
+{
+    if (!m_capacity) {
+        return;
+    }
+    if (m_entries.size() == m_capacity) {
+        m_evictedUntil = m_evictedUntil ? std::max(*m_evictedUntil, m_entries.front().time) : m_entries.front().time;
+        m_evictedUntilId = m_entries.front().id;
+        m_entries.pop_front();
+    }
+    m_entries.emplace_back(std::move(entry));
+}
+
+/** @brief Does the buffer hold all notifications from these modules which were sent since the given time? */
+bool NotificationReplayBuffer::covers(const std::set<std::string>& modules, const sysrepo::NotificationTimeStamp& since) const
+{
+    if (!m_capacity || (m_evictedUntil && since <= *m_evictedUntil)) {
+        return false;
+    }
+    return std::ranges::all_of(modules, [&](const auto& mod) {
+        auto it = m_recordings.find(mod);
+        return it != m_recordings.end() && it->second.since <= since;
+    });
+}
+
+/** @brief Does the buffer hold all notifications from these modules which came after the event with the given ID? */
+bool NotificationReplayBuffer::coversAfter(const std::set<std::string>& modules, uint64_t lastId) const
+{
+    if (!m_capacity || lastId < m_evictedUntilId) {
+        return false;
+    }
+    return std::ranges::all_of(modules, [&](const auto& mod) {
+        auto it = m_recordings.find(mod);
+        return it != m_recordings.end() && it->second.firstId <= lastId + 1;
+    });
+}
+
+const std::deque<NotificationReplayBuffer::Entry>& NotificationReplayBuffer::entries() const
+{
+    return m_entries;
+}
+
+NotificationDispatcher::NotificationDispatcher(sysrepo::Session session, std::size_t replayBufferSize)
+    : m_session(std::move(session))
+    // the upper bit is left out so that the epochs never run out
+    , m_firstEpoch(std::random_device{}() >> 1)
+    , m_epoch(m_firstEpoch)
+    , m_lastEventId(m_epoch << 32)
+    , m_replayBuffer(replayBufferSize)
+{
+    // sysrepo announces each change of the module set, that is the only time when the index has to be rebuilt
+    m_yangLibrarySub = m_session.onNotification(
+        "ietf-yang-library", [this](auto, auto, sysrepo::NotificationType type, auto, auto) {
+            if (type != sysrepo::NotificationType::Realtime) {
+                return;
+            }
+            {
+                std::lock_guard lock{m_modulesMtx};
+                m_notificationModules.reset();
+            }
+            std::lock_guard lock{m_subscriptionMtx};
+            refreshSubscriptions();
+        },
+        "/ietf-yang-library:yang-library-update");
+}
+
+/** @brief notificationModules(), built once and then again only after the YANG modules have changed */
+std::set<std::string> NotificationDispatcher::notificationModules() const
+{
+    std::lock_guard lock{m_modulesMtx};
+    if (!m_notificationModules) {
+        m_notificationModules = rousette::restconf::notificationModules(m_session.getContext());
+    }
+    return *m_notificationModules;
+}
+
+/** @brief Subscribes to those of @p modules which are not subscribed yet; nullopt means all modules with notifications */
+void NotificationDispatcher::subscribeNewModules(const std::optional<std::set<std::string>>& modules)
+{
+    std::set<std::string> newModules;
+    std::ranges::set_difference(modules ? *modules : notificationModules(), m_subscribedModules, std::inserter(newModules, newModules.end()));
+    if (newModules.empty()) {
+        return;
+    }
+
+    subscribeAll(
+        m_notifSubs, m_session, newModules, [this](auto, auto, sysrepo::NotificationType type, const std::optional<libyang::DataNode>& notificationTree, const sysrepo::NotificationTimeStamp& time) {
+            if (type != sysrepo::NotificationType::Realtime) {
+                return;
+            }
+            dispatch(*notificationTree, time);
+        },
+        std::nullopt, std::nullopt, std::nullopt);
+
+    {
+        std::lock_guard lock{m_mtx};
+        m_replayBuffer.startRecording(newModules, std::chrono::system_clock::now(), m_lastEventId + 1);
+    }
+    m_subscribedModules.merge(newModules);
+}
+
+/** @brief Follows a change of the YANG modules
+ *
+ * Modules which are gone are forgotten, so that they are subscribed to again if they come back. Clients which want
+ * notifications from all modules get those from the new modules as well.
+ */
+void NotificationDispatcher::refreshSubscriptions()
+{
+    auto modules = notificationModules();
+    for (auto it = m_subscribedModules.begin(); it != m_subscribedModules.end();) {
+        if (modules.contains(*it)) {
+            ++it;
+        } else {
+            spdlog::debug("Module {} with notifications is gone", *it);
+            it = m_subscribedModules.erase(it);
+        }
+    }
+
+    bool wantsAllModules;
+    {
+        std::lock_guard lock{m_mtx};
+        wantsAllModules = std::ranges::any_of(m_clients, [](const auto& entry) { return !entry.second.modules; });
+    }
+    if (wantsAllModules) {
+        subscribeNewModules(std::nullopt);
+    }
+}
+
+uint64_t NotificationDispatcher::add(Client client)
+{
+    {
+        // Not under m_mtx; sysrepo might be waiting for a notification callback to finish, and that one might be waiting for m_mtx
+        std::lock_guard lock{m_subscriptionMtx};
+        subscribeNewModules(client.modules);
+    }
+
+    std::lock_guard lock{m_mtx};
+    m_clients.emplace(++m_lastId, std::move(client));
+    return m_lastId;
+}
+
+/** @brief Adds a client which wants to replay notifications since @p startTime first, if these are still in the replay buffer
+ *
+ * @return The client ID, or nullopt if the replay has to be served by sysrepo
+ */
+std::optional<uint64_t> NotificationDispatcher::addWithReplay(Client client, const sysrepo::NotificationTimeStamp& startTime)
+{
+    auto stopTime = client.stopTime;
+    return addReplaying(
+        std::move(client),
+        [&](const auto& modules) { return m_replayBuffer.covers(modules, startTime); },
+        [&](const auto& entry) { return entry.time >= startTime && (!stopTime || entry.time < *stopTime); });
+}
+
+/** @brief Adds a client which has reconnected, and which wants the notifications it has missed first
+ *
+ * An ID from a previous run of the server says nothing about what the client has seen since this run started,
+ * so such a client gets everything from this run instead.
+ *
+ * @return The client ID, or nullopt if the missed notifications are not in the replay buffer anymore
+ */
+std::optional<uint64_t> NotificationDispatcher::addAfterEvent(Client client, uint64_t lastEventId)
+{
+    {
+        // the epoch only grows, so an ID which is valid now stays valid
+        std::lock_guard lock{m_mtx};
+        if (auto epoch = lastEventId >> 32; epoch < m_firstEpoch || epoch > m_epoch) {
+            spdlog::debug("Event {} comes from a previous run, replaying everything since the start", lastEventId);
+            lastEventId = m_firstEpoch << 32;
+        }
+    }
+
+    auto stopTime = client.stopTime;
+    return addReplaying(
+        std::move(client),
+        [&](const auto& modules) { return lastEventId <= m_lastEventId && m_replayBuffer.coversAfter(modules, lastEventId); },
+        [&](const auto& entry) { return entry.id > lastEventId && (!stopTime || entry.time < *stopTime); });
+}
+
+/** @brief Sends the wanted notifications from the replay buffer to a new client, and adds that client
+ *
+ * The replayed notifications are sent before this returns, and no notification can slip in between.
+ */
+std::optional<uint64_t> NotificationDispatcher::addReplaying(Client client, const std::function<bool(const std::set<std::string>& modules)>& isCovered, const std::function<bool(const NotificationReplayBuffer::Entry& entry)>& isWanted)
+{
+    if (!hasReplayBuffer()) {
+        return std::nullopt;
+    }
+
+    auto modules = client.modules ? *client.modules : notificationModules();
+    {
+        // even when this replay cannot be served from the buffer, the next one might
+        std::lock_guard lock{m_subscriptionMtx};
+        subscribeNewModules(modules);
+    }
+
+    std::lock_guard lock{m_mtx};
+    if (!isCovered(modules)) {
+        return std::nullopt;
+    }
+
+    // unlike dispatch(), this publishes under the lock so that no live notification can overtake the replayed ones;
+    // the signal is new and it has just one subscriber
+    for (const auto& entry : m_replayBuffer.entries()) {
+        if (!isWanted(entry) || !accepts(client, entry.notification)) {
+            continue;
+        }
+        (*client.signal)(entry.event(m_session.getContext(), client.dataFormat));
+    }
+
+    m_clients.emplace(++m_lastId, std::move(client));
+    return m_lastId;
+}
+
+void NotificationDispatcher::remove(uint64_t id)
+{
+    std::lock_guard lock{m_mtx};
+    m_clients.erase(id);
+}
+
+bool NotificationDispatcher::hasReplayBuffer() const
+{
+    return m_replayBuffer.capacity() > 0;
+}
+
+/** @brief A new event ID; once the counter in its lower half runs out, the next epoch starts, so the IDs keep growing */
+uint64_t NotificationDispatcher::nextEventIdLocked()
+{
+    if ((m_lastEventId & 0xffff'ffff) == 0xffff'ffff) {
+        m_lastEventId = ++m_epoch << 32;
+        spdlog::info("Event IDs of notifications continue in epoch {}", m_epoch);
+    }
+    return ++m_lastEventId;
+}
+
+void NotificationDispatcher::dispatch(libyang::DataNode notification, const sysrepo::NotificationTimeStamp& time)
+{
+    auto root = notification;
+    while (root.parent()) {
+        root = *root.parent();
+    }
+
+    const std::string module{notification.schema().module().name()};
+
+    // clients usually share just a handful of NACM users, filters and data formats, so evaluate each of them at most once
+    std::map<std::optional<std::string>, bool> nacmAllowed;
+    std::map<std::string, bool> filterMatches;
+    std::map<libyang::DataFormat, rousette::http::EventPtr> events;
+    std::vector<std::pair<std::shared_ptr<rousette::http::EventStream::Signal>, libyang::DataFormat>> targets;
+
+    std::unique_lock lock{m_mtx};
+    const auto eventId = nextEventIdLocked();
+    if (m_replayBuffer.capacity()) {
+        // the tree belongs to sysrepo, the buffer needs its own copy; it is only serialized when replayed
+        m_replayBuffer.push({eventId, time, notification.duplicate(libyang::DuplicationOptions::Recursive | libyang::DuplicationOptions::WithParents)});
+    }
+
+    for (auto& [id, client] : m_clients) {
+        if (client.modules && !client.modules->contains(module)) {
+            continue;
+        }
+        if (client.stopTime && time >= *client.stopTime) {
+            continue;
+        }
+
+        auto user = client.session.getNacmUser();
+        auto nacmIt = nacmAllowed.find(user);
+        if (nacmIt == nacmAllowed.end()) {
+            nacmIt = nacmAllowed.emplace(user, client.session.checkNacmOperation(notification)).first;
+        }
+        if (!nacmIt->second) {
+            continue;
+        }
+
+        auto matches = std::ranges::all_of(client.filters, [&](const auto& filter) {
+            auto filterIt = filterMatches.find(filter);
+            if (filterIt == filterMatches.end()) {
+                filterIt = filterMatches.emplace(filter, !root.findXPath(filter).empty()).first;
+            }
+            return filterIt->second;
+        });
+        if (!matches) {
+            continue;
+        }
+
+        targets.emplace_back(client.signal, client.dataFormat);
+    }
+
+    // Publishing might block on the clients' queues, so it must not hold up add() and remove().
+    // The notifications still go out in order because sysrepo invokes this from a single thread.
+    // A client which is removed meanwhile might still get this one; its slot only holds a weak reference to the stream.
+    lock.unlock();
+
+    for (const auto& [signal, dataFormat] : targets) {
+        auto& event = events[dataFormat];
+        if (!event) {
+            event = rousette::http::makeEvent(as_restconf_notification(m_session.getContext(), dataFormat, notification, time), eventId);
+        }
+        (*signal)(event);
+    }
+}
+
+/** @brief Checks that the XPath filter selects at least one notification, like sysrepo does when subscribing
+ *
+ * @return Names of modules whose notifications can be selected by the filter
+ */
+std::set<std::string> validateNotificationFilter(const libyang::Context& ctx, const std::string& filter)
+{
+    std::set<std::string> modules;
+    try {
+        for (const auto& node : ctx.findXPath(filter)) {
+            for (std::optional<libyang::SchemaNode> n = node; n; n = n->parent()) {
+                if (n->nodeType() == libyang::NodeType::Notification) {
+                    modules.emplace(n->module().name());
+                    break;
+                }
+            }
+        }
+    } catch (const libyang::Error&) {
+        // invalid XPath, this is reported just like an XPath which does not select anything
+    }
+
+    if (modules.empty()) {
+        throw ErrorResponse(400, "application", "invalid-argument", "XPath \"" + filter + "\" does not select any notifications.");
+    }
+    return modules;
+}
+
+/** @brief Checks the operator-defined streams, to be called once at startup */
+void validateNotificationStreams(const libyang::Context& ctx, const NotificationStreamsConfig& config)
+{
+    for (const auto& [name, filter] : config.filtered) {
+        if (name.empty() || name == "NETCONF" || !std::ranges::all_of(name, [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.'; })) {
+            throw std::invalid_argument("Invalid notification stream name \"" + name + "\"");
+        }
+        try {
+            validateNotificationFilter(ctx, filter);
+        } catch (const ErrorResponse& e) {
+            throw std::invalid_argument("Notification stream \"" + name + "\": " + e.errorMessage);
+        }
+    }
+}
+
+/** @brief Looks up a notification stream by its name
+ *
+ * The default NETCONF stream takes precedence over the operator-defined streams, which take precedence over the per-module ones.
+ */
+std::optional<NotificationStreamDefinition> findNotificationStream(const libyang::Context& ctx, const NotificationStreamsConfig& config, const NotificationDispatcher& dispatcher, const std::string& name)
+{
+    if (name == "NETCONF") {
+        return NotificationStreamDefinition{};
+    }
+    if (auto it = config.filtered.find(name); it != config.filtered.end()) {
+        return NotificationStreamDefinition{validateNotificationFilter(ctx, it->second), it->second};
+    }
+    if (config.perModule && dispatcher.notificationModules().contains(name)) {
+        return NotificationStreamDefinition{std::set<std::string>{name}, std::nullopt};
+    }
+    return std::nullopt;
+}
+
 NotificationStream::NotificationStream(
     const nghttp2::asio_http2::server::request& req,
     const nghttp2::asio_http2::server::response& res,
     std::shared_ptr<rousette::http::EventStream::Signal> signal,
     sysrepo::Session session,
-    libyang::DataFormat dataFormat,
-    const std::optional<std::string>& filter,
-    const std::optional<sysrepo::NotificationTimeStamp>& startTime,
-    const std::optional<sysrepo::NotificationTimeStamp>& stopTime)
-    : EventStream(req, res, *signal)
+    const NotificationSubscription& subscription,
+    std::shared_ptr<NotificationDispatcher> dispatcher,
+    const rousette::http::DeliveryOptions& options)
+    : EventStream(req, res, *signal, {}, withBatchEnvelope(options, subscription.dataFormat))
     , m_notificationSignal(signal)
     , m_session(std::move(session))
-    , m_dataFormat(dataFormat)
-    , m_filter(filter)
-    , m_startTime(startTime)
-    , m_stopTime(stopTime)
+    , m_stream(subscription.stream)
+    , m_dataFormat(subscription.dataFormat)
+    , m_filter(subscription.filter)
+    , m_startTime(subscription.startTime)
+    , m_stopTime(subscription.stopTime)
+    , m_lastEventId(subscription.lastEventId)
+    , m_dispatcher(std::move(dispatcher))
+    , m_counters(options.counters)
 {
     auto now = std::chrono::system_clock::now();
 
-    if (startTime && stopTime && startTime >= stopTime) {
+    if (m_startTime && m_stopTime && m_startTime >= m_stopTime) {
         throw ErrorResponse(400, "application", "invalid-argument", "stop-time must be greater than start-time");
-    } else if (startTime && startTime > now) {
+    } else if (m_startTime && m_startTime > now) {
         throw ErrorResponse(400, "application", "invalid-argument", "start-time is in the future");
-    } else if (!startTime && stopTime) {
+    } else if (!m_startTime && m_stopTime) {
         throw ErrorResponse(400, "application", "invalid-argument", "stop-time must be used with start-time");
     }
 }
 
+NotificationStream::~NotificationStream()
+{
+    if (m_dispatcherId) {
+        m_dispatcher->remove(*m_dispatcherId);
+    }
+}
+
 void NotificationStream::activate()
 {
-    for (const auto& mod : m_session.getContext().modules()) {
-        if (!canBeSubscribed(mod)) {
-            continue;
+    // the replays from the dispatcher are published right away
+    subscribe();
+
+    auto dispatcherClient = [this]() {
+        NotificationDispatcher::Client client{m_session, m_dataFormat, m_stream.modules, {}, m_notificationSignal, m_stopTime};
+        for (const auto& filter : {m_stream.filter, m_filter}) {
+            if (!filter) {
+                continue;
+            }
+            // a filter might restrict the set of modules even further
+            auto filterModules = validateNotificationFilter(m_session.getContext(), *filter);
+            if (client.modules) {
+                std::erase_if(*client.modules, [&](const auto& mod) { return !filterModules.contains(mod); });
+            } else {
+                client.modules = std::move(filterModules);
+            }
+            client.filters.emplace_back(*filter);
         }
+        return client;
+    };
 
-        try {
-            subscribe(m_notifSubs, m_session, mod.name(), *m_notificationSignal, m_dataFormat, m_filter, m_startTime, m_stopTime);
-        } catch (sysrepo::ErrorWithCode& e) {
-            if (e.code() == sysrepo::ErrorCode::InvalidArgument) {
-                throw ErrorResponse(400, "application", "invalid-argument", e.what());
+    if (m_lastEventId && m_dispatcher->hasReplayBuffer()) {
+        m_dispatcherId = m_dispatcher->addAfterEvent(dispatcherClient(), *m_lastEventId);
+        if (!m_dispatcherId) {
+            spdlog::debug("Cannot resume after event {}, the missed notifications are not available anymore", *m_lastEventId);
+        }
+    }
+
+    if (m_dispatcherId) {
+        // the client has resumed where it left off
+    } else if (m_startTime) {
+        auto replayStart = std::chrono::steady_clock::now();
+
+        if (m_dispatcher->hasReplayBuffer()) {
+            m_dispatcherId = m_dispatcher->addWithReplay(dispatcherClient(), *m_startTime);
+        }
+
+        if (m_dispatcherId) {
+            auto duration = microsecondsSince(replayStart);
+            spdlog::debug("Replay served from memory in {} us", duration);
+            if (m_counters) {
+                ++m_counters->memoryReplays;
+                m_counters->memoryReplayMicroseconds += duration;
+            }
+        } else {
+            // replays need their own subscriptions; sysrepo takes just one filter, so the stream's filter might have to be checked here
+            std::optional<std::string> extraFilter;
+            if (m_filter) {
+                extraFilter = m_stream.filter;
             }
 
-            /* We are iterating through all modules in order to subscribe to every possible module.
-             * If the module does not define any notifications or the module does not exist then sysrepo throws with ErrorCode::NotFound
-             * (see sysrepo's sr_notif_subscribe and sr_subscr_notif_xpath_check).
-             *
-             * We can either scan the YANG schema and search for notifications nodes (like netopeer2) or ignore this particular exception.
-             */
-            if (e.code() != sysrepo::ErrorCode::NotFound) {
-                throw;
+            // The replay is done once each subscribed module reports its completion. Callbacks might come before
+            // the number of modules is known, so this goes negative first, and zero is only reached once all is done.
+            auto pendingReplays = std::make_shared<std::atomic<int64_t>>(0);
+            auto replayDone = [replayStart, counters = m_counters]() {
+                auto duration = microsecondsSince(replayStart);
+                spdlog::debug("Replay served from sysrepo in {} us", duration);
+                if (counters) {
+                    ++counters->storedReplays;
+                    counters->storedReplayMicroseconds += duration;
+                }
+            };
+
+            auto subscribed = subscribeAll(
+                m_notifSubs, m_session, m_stream.modules ? *m_stream.modules : m_dispatcher->notificationModules(), [signal = m_notificationSignal, dataFormat = m_dataFormat, extraFilter, pendingReplays, replayDone](auto session, auto, sysrepo::NotificationType type, const std::optional<libyang::DataNode>& notificationTree, const sysrepo::NotificationTimeStamp& time) {
+                    if (type == sysrepo::NotificationType::ReplayComplete) {
+                        if (--*pendingReplays == 0) {
+                            replayDone();
+                        }
+                        return;
+                    }
+                    if (type != sysrepo::NotificationType::Realtime && type != sysrepo::NotificationType::Replay) {
+                        return;
+                    }
+
+                    if (extraFilter) {
+                        auto root = *notificationTree;
+                        while (root.parent()) {
+                            root = *root.parent();
+                        }
+                        if (root.findXPath(*extraFilter).empty()) {
+                            return;
+                        }
+                    }
+
+                    (*signal)(rousette::http::makeEvent(as_restconf_notification(session.getContext(), dataFormat, *notificationTree, time)));
+                },
+                m_filter ? m_filter : m_stream.filter, m_startTime, m_stopTime);
+            if (subscribed && (*pendingReplays += subscribed) == 0) {
+                replayDone();
             }
         }
+    } else {
+        m_dispatcherId = m_dispatcher->add(dispatcherClient());
     }
 
     EventStream::activate();
 }
 
 /** @brief Creates and fills ietf-restconf-monitoring:restconf-state/stream. To be called in oper callback. */
-void notificationStreamList(sysrepo::Session& session, std::optional<libyang::DataNode>& parent, const std::string& streamsPrefix)
+void notificationStreamList(sysrepo::Session& session, std::optional<libyang::DataNode>& parent, const std::string& streamsPrefix, const NotificationStreamsConfig& config, const NotificationDispatcher& dispatcher)
 {
-    static const auto prefix = "/ietf-restconf-monitoring:restconf-state/streams/stream[name='NETCONF']"s;
+    auto ctx = session.getContext();
+    auto allModules = dispatcher.notificationModules();
 
-    decltype(sysrepo::ModuleReplaySupport::earliestNotification) globalEarliestNotification;
-    bool replayEnabled = false;
+    auto addStream = [&](const std::string& name, const std::string& description, const std::set<std::string>& modules) {
+        const auto prefix = streamListXPath + "[name='" + name + "']";
 
-    for (const auto& mod : session.getContext().modules()) {
-        if (!canBeSubscribed(mod)) {
-            continue;
+        decltype(sysrepo::ModuleReplaySupport::earliestNotification) globalEarliestNotification;
+        bool replayEnabled = false;
+
+        for (const auto& mod : modules) {
+            auto replay = session.getConnection().getModuleReplaySupport(mod);
+            replayEnabled |= replay.enabled;
+
+            if (replay.earliestNotification) {
+                if (!globalEarliestNotification) {
+                    globalEarliestNotification = replay.earliestNotification;
+                } else {
+                    globalEarliestNotification = std::min(*replay.earliestNotification, *globalEarliestNotification);
+                }
+            }
+        }
+
+        if (!parent) {
+            parent = ctx.newPath(prefix + "/description", description);
+        } else {
+            parent->newPath(prefix + "/description", description);
         }
+        parent->newPath(prefix + "/access[encoding='xml']/location", streamsPrefix + name + "/XML");
+        parent->newPath(prefix + "/access[encoding='json']/location", streamsPrefix + name + "/JSON");
 
-        auto replay = session.getConnection().getModuleReplaySupport(mod.name());
-        replayEnabled |= replay.enabled;
+        if (replayEnabled) {
+            parent->newPath(prefix + "/replay-support", "true");
 
-        if (replay.earliestNotification) {
-            if (!globalEarliestNotification) {
-                globalEarliestNotification = replay.earliestNotification;
-            } else {
-                globalEarliestNotification = std::min(*replay.earliestNotification, *globalEarliestNotification);
+            if (globalEarliestNotification) {
+                parent->newPath(prefix + "/replay-log-creation-time", libyang::yangTimeFormat(*globalEarliestNotification, libyang::TimezoneInterpretation::Local));
             }
         }
-    }
+    };
 
-    if (!parent) {
-        parent = session.getContext().newPath(prefix + "/description", "Default NETCONF notification stream");
-    } else {
-        parent->newPath(prefix + "/description", "Default NETCONF notification stream");
-    }
-    parent->newPath(prefix + "/access[encoding='xml']/location", streamsPrefix + "NETCONF/XML");
-    parent->newPath(prefix + "/access[encoding='json']/location", streamsPrefix + "NETCONF/JSON");
+    addStream("NETCONF", "Default NETCONF notification stream", allModules);
 
-    if (replayEnabled) {
-        parent->newPath(prefix + "/replay-support", "true");
+    for (const auto& [name, filter] : config.filtered) {
+        std::set<std::string> modules;
+        try {
+            modules = validateNotificationFilter(ctx, filter);
+        } catch (const ErrorResponse&) {
+            // the modules have changed since startup
+            continue;
+        }
+        addStream(name, "Notifications selected by XPath " + filter, modules);
+    }
 
-        if (globalEarliestNotification) {
-            parent->newPath(prefix + "/replay-log-creation-time", libyang::yangTimeFormat(*globalEarliestNotification, libyang::TimezoneInterpretation::Local));
+    if (config.perModule) {
+        for (const auto& mod : allModules) {
+            if (mod == "NETCONF" || config.filtered.contains(mod)) {
+                continue;
+            }
+            addStream(mod, "Notifications from YANG module " + mod, {mod});
         }
     }
 }
@@ -5,7 +5,14 @@
  *
  */
 
+#pragma once
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <set>
+#include <vector>
 #include <sysrepo-cpp/Session.hpp>
 #include <sysrepo-cpp/Subscription.hpp>
 #include "http/EventStream.h"
@@ -16,6 +23,142 @@ enum class DataFormat;
 
 namespace rousette::restconf {
 
+/** @brief Notification streams which are available in addition to the default NETCONF stream */
+struct NotificationStreamsConfig {
+    /** @short Provide one stream for each module which defines some notifications, named after that module */
+    bool perModule = false;
+    /** @short Streams with a fixed XPath filter, indexed by the stream name */
+    std::map<std::string, std::string> filtered;
+    /** @short How many recent notifications to keep in memory for replays; zero disables the in-memory replays */
+    std::size_t replayBufferSize = 0;
+};
+
+/** @brief What a single notification stream consists of */
+struct NotificationStreamDefinition {
+    /** @short Modules whose notifications are part of this stream; all modules with notifications if not set */
+    std::optional<std::set<std::string>> modules;
+    std::optional<std::string> filter;
+};
+
+/** @brief What a client has asked for when subscribing to a notification stream */
+struct NotificationSubscription {
+    NotificationStreamDefinition stream;
+    libyang::DataFormat dataFormat;
+    /** @short An XPath filter of the client, on top of the filter of the stream */
+    std::optional<std::string> filter;
+    std::optional<sysrepo::NotificationTimeStamp> startTime;
+    std::optional<sysrepo::NotificationTimeStamp> stopTime;
+    /** @short The Last-Event-ID of a client which reconnects */
+    std::optional<uint64_t> lastEventId;
+};
+
+/** @brief Recent notifications, kept in memory so that replays do not have to go to sysrepo
+ *
+ * The buffer only knows about notifications from modules which it records. It is complete for a module since the time
+ * (and the event ID) the module is recorded, or since the newest notification which has been evicted, whichever is later.
+ *
+ * Not thread-safe, the caller is responsible for locking.
+ */
+class NotificationReplayBuffer {
+public:
+    struct Entry {
+        Entry(uint64_t id, const sysrepo::NotificationTimeStamp& time, libyang::DataNode notification);
+
+        /** @short The SSE event ID, increasing with each notification */
+        uint64_t id;
+        sysrepo::NotificationTimeStamp time;
+        /** @short The notification node, within a copy of the complete data tree */
+        libyang::DataNode notification;
+
+        rousette::http::EventPtr event(const libyang::Context& ctx, libyang::DataFormat dataFormat) const;
+
+    private:
+        /** @short Serialized on the first replay in each format, most notifications are never replayed */
+        mutable std::map<libyang::DataFormat, rousette::http::EventPtr> m_events;
+    };
+
+    explicit NotificationReplayBuffer(std::size_t capacity);
+    std::size_t capacity() const;
+    void startRecording(const std::set<std::string>& modules, const sysrepo::NotificationTimeStamp& since, uint64_t firstId);
+    void push(Entry entry);
+    bool covers(const std::set<std::string>& modules, const sysrepo::NotificationTimeStamp& since) const;
+    bool coversAfter(const std::set<std::string>& modules, uint64_t lastId) const;
+    const std::deque<Entry>& entries() const;
+
+private:
+    struct Recording {
+        sysrepo::NotificationTimeStamp since;
+        uint64_t firstId;
+    };
+
+    std::size_t m_capacity;
+    std::deque<Entry> m_entries;
+    std::map<std::string, Recording> m_recordings;
+    std::optional<sysrepo::NotificationTimeStamp> m_evictedUntil;
+    uint64_t m_evictedUntilId = 0;
+};
+
+/** @brief Receives realtime NETCONF notifications through a single set of sysrepo subscriptions and hands them over to all clients
+ *
+ * Each notification is checked against NACM, and against the modules and XPath filters of each client.
+ * Modules are subscribed to only once some client needs them.
+ * It is serialized at most once per data format, and the serialized event is shared by all clients which receive it.
+ * Recent notifications are kept in a NotificationReplayBuffer so that replays of the recent past are served from memory.
+ */
+class NotificationDispatcher {
+public:
+    struct Client {
+        /** @short Session with the NACM user of the client */
+        sysrepo::Session session;
+        libyang::DataFormat dataFormat;
+        /** @short Only notifications from these modules are delivered; all modules if not set */
+        std::optional<std::set<std::string>> modules;
+        /** @short XPath filters, all of which have to select something from the notification */
+        std::vector<std::string> filters;
+        std::shared_ptr<rousette::http::EventStream::Signal> signal;
+        /** @short Notifications from this time on are not delivered */
+        std::optional<sysrepo::NotificationTimeStamp> stopTime;
+    };
+
+    explicit NotificationDispatcher(sysrepo::Session session, std::size_t replayBufferSize = 0);
+    std::set<std::string> notificationModules() const;
+    uint64_t add(Client client);
+    std::optional<uint64_t> addWithReplay(Client client, const sysrepo::NotificationTimeStamp& startTime);
+    std::optional<uint64_t> addAfterEvent(Client client, uint64_t lastEventId);
+    void remove(uint64_t id);
+    bool hasReplayBuffer() const;
+
+private:
+    sysrepo::Session m_session;
+    mutable std::mutex m_modulesMtx; // for `m_notificationModules`
+    /** @short Cached result of notificationModules(), reset when the set of YANG modules changes */
+    mutable std::optional<std::set<std::string>> m_notificationModules;
+    std::optional<sysrepo::Subscription> m_yangLibrarySub;
+    std::mutex m_subscriptionMtx; // for `m_notifSubs` and `m_subscribedModules`
+    std::optional<sysrepo::Subscription> m_notifSubs;
+    std::set<std::string> m_subscribedModules;
+    std::mutex m_mtx; // for `m_clients`, `m_lastId`, `m_epoch`, `m_lastEventId` and `m_replayBuffer`
+    std::map<uint64_t, Client> m_clients;
+    uint64_t m_lastId = 0;
+    /** @short Event IDs carry a random epoch in their upper half so that the IDs of each run of the server are distinct */
+    const uint64_t m_firstEpoch;
+    /** @short The epoch of the latest event ID; the next one starts when the counter in the lower half runs out */
+    uint64_t m_epoch;
+    uint64_t m_lastEventId;
+    NotificationReplayBuffer m_replayBuffer;
+
+    void subscribeNewModules(const std::optional<std::set<std::string>>& modules);
+    void refreshSubscriptions();
+    uint64_t nextEventIdLocked();
+    std::optional<uint64_t> addReplaying(Client client, const std::function<bool(const std::set<std::string>& modules)>& isCovered, const std::function<bool(const NotificationReplayBuffer::Entry& entry)>& isWanted);
+    void dispatch(libyang::DataNode notification, const sysrepo::NotificationTimeStamp& time);
+};
+
+std::set<std::string> notificationModules(const libyang::Context& ctx);
+std::set<std::string> validateNotificationFilter(const libyang::Context& ctx, const std::string& filter);
+void validateNotificationStreams(const libyang::Context& ctx, const NotificationStreamsConfig& config);
+std::optional<NotificationStreamDefinition> findNotificationStream(const libyang::Context& ctx, const NotificationStreamsConfig& config, const NotificationDispatcher& dispatcher, const std::string& name);
+
 /** @brief Subscribes to NETCONF notifications and sends them via HTTP/2 Event stream.
  *
  * The class must be instantiated as a shared_ptr. Once the instance is created
@@ -31,11 +174,16 @@ namespace rousette::restconf {
 class NotificationStream : public rousette::http::EventStream {
     std::shared_ptr<rousette::http::EventStream::Signal> m_notificationSignal;
     sysrepo::Session m_session;
+    NotificationStreamDefinition m_stream;
     libyang::DataFormat m_dataFormat;
     std::optional<std::string> m_filter;
     std::optional<sysrepo::NotificationTimeStamp> m_startTime;
     std::optional<sysrepo::NotificationTimeStamp> m_stopTime;
+    std::optional<uint64_t> m_lastEventId;
     std::optional<sysrepo::Subscription> m_notifSubs;
+    std::shared_ptr<NotificationDispatcher> m_dispatcher;
+    std::optional<uint64_t> m_dispatcherId;
+    std::shared_ptr<rousette::http::StreamCounters> m_counters;
 
 public:
     NotificationStream(
@@ -43,13 +191,13 @@ public:
         const nghttp2::asio_http2::server::response& res,
         std::shared_ptr<rousette::http::EventStream::Signal> signal,
         sysrepo::Session sess,
-        libyang::DataFormat dataFormat,
-        const std::optional<std::string>& filter,
-        const std::optional<sysrepo::NotificationTimeStamp>& startTime,
-        const std::optional<sysrepo::NotificationTimeStamp>& stopTime);
+        const NotificationSubscription& subscription,
+        std::shared_ptr<NotificationDispatcher> dispatcher,
+        const rousette::http::DeliveryOptions& options = {});
+    ~NotificationStream();
     void activate();
 };
 
-void notificationStreamList(sysrepo::Session& session, std::optional<libyang::DataNode>& parent, const std::string& streamsPrefix);
+void notificationStreamList(sysrepo::Session& session, std::optional<libyang::DataNode>& parent, const std::string& streamsPrefix, const NotificationStreamsConfig& config, const NotificationDispatcher& dispatcher);
 libyang::DataNode replaceStreamLocations(const std::optional<std::string>& schemeAndHost, libyang::DataNode& node);
 }
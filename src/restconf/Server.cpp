@@ -5,10 +5,12 @@
  *
 */
 
+#include <boost/asio/post.hpp>
 #include <experimental/iterator>
 #include <libyang-cpp/Enum.hpp>
 #include <libyang-cpp/Time.hpp>
 #include <nghttp2/asio_http2_server.h>
+#include <random>
 #include <spdlog/spdlog.h>
 #include <sysrepo-cpp/Enum.hpp>
 #include <sysrepo-cpp/Subscription.hpp>
@@ -19,6 +21,7 @@
 #include "auth/Http.h"
 #include "auth/PAM.h"
 #include "restconf/Server.h"
+#include "restconf/YangPush.h"
 #include "restconf/YangSchemaLocations.h"
 #include "restconf/uri.h"
 #include "restconf/utils/dataformat.h"
@@ -37,16 +40,6 @@ using nghttp2::asio_http2::server::response;
 namespace rousette::restconf {
 
 namespace {
-constexpr auto notifPrefix = R"json({"ietf-restconf:notification":{"eventTime":")json";
-constexpr auto notifMid = R"json(","ietf-yang-push:push-update":{"datastore-contents":)json";
-constexpr auto notifSuffix = R"json(}}})json";
-
-template <typename T>
-auto as_restconf_push_update(const std::string& content, const T& time)
-{
-    return notifPrefix + libyang::yangTimeFormat(time, libyang::TimezoneInterpretation::Local) + notifMid + content + notifSuffix;
-}
-
 constexpr auto restconfRoot = "/restconf/";
 constexpr auto yangSchemaRoot = "/yang/";
 constexpr auto netconfStreamRoot = "/streams/";
@@ -81,6 +74,24 @@ auto contentType(const libyang::DataFormat dataFormat)
     return contentType(asMimeType(dataFormat));
 }
 
+/** @brief The interval between events of a stream which is limited to the `rousette-max-rate` events per second */
+std::chrono::microseconds rateInterval(const unsigned maxRate)
+{
+    return std::chrono::microseconds{1'000'000} / maxRate;
+}
+
+/** @brief Sends a response whose body is completely known upfront, announcing its length
+ *
+ * Successful responses to HEAD do not go through here; they are answered without printing any body, and therefore without
+ * a content-length (RFC 9110, sec. 8.6).
+ */
+void sendResponse(const response& res, const int code, nghttp2::asio_http2::header_map headers, std::string body)
+{
+    headers.emplace("content-length", nghttp2::asio_http2::header_value{std::to_string(body.size()), false});
+    res.write_head(code, std::move(headers));
+    res.end(std::move(body));
+}
+
 /** @brief Rejects the request with an error response and sends the HTTP response. Recommend to use rejectWithError which has more convenient API.
  * @pre The error errorContainer must be a node from ietf-restconf module, grouping "errors", container "errors".
  * */
@@ -102,8 +113,7 @@ void rejectWithErrorImpl(libyang::Context ctx, const libyang::DataFormat& dataFo
         headers.merge(httpOptionsHeaders(allowedHttpMethodsForUri(ctx, req.uri().path)));
     }
 
-    res.write_head(code, headers);
-    res.end(*parent.printStr(dataFormat, libyang::PrintFlags::WithSiblings));
+    sendResponse(res, code, std::move(headers), *parent.printStr(dataFormat, libyang::PrintFlags::WithSiblings));
 }
 
 void rejectWithError(libyang::Context ctx, const libyang::DataFormat& dataFormat, const request& req, const response& res, const int code, const std::string errorType, const std::string& errorTag, const std::string& errorMessage, const std::optional<std::string>& errorPath)
@@ -319,21 +329,26 @@ constexpr auto withRestconfExceptions(T func, U rejectWithError)
 
 #define WITH_RESTCONF_EXCEPTIONS(FUNC, REJECT_FUNC) withRestconfExceptions<decltype(FUNC)>(FUNC, REJECT_FUNC)
 
-/** @brief Prepare sysrepo edit for PUT and PATCH (both PLAIN and YANG) requests from uri and string data.
+/** @brief Checks that a top-level node provided in the request body is the node indicated by the URI */
+void validateTopLevelReplacement(const libyang::DataNode& node, const PathSegment& lastPathSegment)
+{
+    if (!isSameNode(node, lastPathSegment)) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "Data contains invalid node.", node.path());
+    }
+    if (auto offendingNode = checkKeysMismatch(node, lastPathSegment)) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "List key mismatch between URI path and data.", offendingNode->path());
+    }
+}
+
+/** @brief Prepare sysrepo edit from an URI which was already split into the parent path and the last segment.
  *
- * @return A pair of the edit tree and a node that should be replaced (i.e., the NETCONF operation is set on it).
+ * @see createEditForPutAndPatch
  */
-libyang::CreatedNodes createEditForPutAndPatch(libyang::Context& ctx, const std::string& uriPath, const std::optional<std::string>& valueStr, const libyang::DataFormat& dataFormat)
+libyang::CreatedNodes createEditForPutAndPatch(libyang::Context& ctx, const std::string& uriPath, const std::string& lyParentPath, const PathSegment& lastPathSegment, const std::optional<std::string>& valueStr, const libyang::DataFormat& dataFormat)
 {
     std::optional<libyang::DataNode> editNode;
     std::optional<libyang::DataNode> replacementNode;
 
-    /* PUT and PATCH requests replace the node indicated by the URI path with the tree provided in the request body.
-     * The tree starts with the node indicated by the URI.
-     * This means that in libyang, we must create the parent node of the URI path and parse the data into it.
-     */
-    auto [lyParentPath, lastPathSegment] = asLibyangPathSplit(ctx, uriPath);
-
     if (!valueStr) {
         // Some YANG patch operations do not have a value node, e.g., delete or move
         auto lyFullPath = asRestconfRequest(ctx, "PATCH", uriPath).path;
@@ -369,13 +384,7 @@ libyang::CreatedNodes createEditForPutAndPatch(libyang::Context& ctx, const std:
         if (auto parent = ctx.parseData(*valueStr, dataFormat, libyang::ParseOptions::Strict | libyang::ParseOptions::NoState | libyang::ParseOptions::ParseOnly); parent) {
             editNode = parent;
             replacementNode = parent;
-
-            if (!isSameNode(*replacementNode, lastPathSegment)) {
-                throw ErrorResponse(400, "protocol", "invalid-value", "Data contains invalid node.", replacementNode->path());
-            }
-            if (auto offendingNode = checkKeysMismatch(*parent, lastPathSegment)) {
-                throw ErrorResponse(400, "protocol", "invalid-value", "List key mismatch between URI path and data.", offendingNode->path());
-            }
+            validateTopLevelReplacement(*replacementNode, lastPathSegment);
         }
     }
 
@@ -386,6 +395,20 @@ libyang::CreatedNodes createEditForPutAndPatch(libyang::Context& ctx, const std:
     return {editNode, replacementNode};
 }
 
+/** @brief Prepare sysrepo edit for PUT and PATCH (both PLAIN and YANG) requests from uri and string data.
+ *
+ * @return A pair of the edit tree and a node that should be replaced (i.e., the NETCONF operation is set on it).
+ */
+libyang::CreatedNodes createEditForPutAndPatch(libyang::Context& ctx, const std::string& uriPath, const std::optional<std::string>& valueStr, const libyang::DataFormat& dataFormat)
+{
+    /* PUT and PATCH requests replace the node indicated by the URI path with the tree provided in the request body.
+     * The tree starts with the node indicated by the URI.
+     * This means that in libyang, we must create the parent node of the URI path and parse the data into it.
+     */
+    auto [lyParentPath, lastPathSegment] = asLibyangPathSplit(ctx, uriPath);
+    return createEditForPutAndPatch(ctx, uriPath, lyParentPath, lastPathSegment, valueStr, dataFormat);
+}
+
 void processActionOrRPC(std::shared_ptr<RequestContext> requestCtx, const std::chrono::milliseconds timeout)
 {
     requestCtx->sess.switchDatastore(sysrepo::Datastore::Operational);
@@ -430,11 +453,7 @@ void processActionOrRPC(std::shared_ptr<RequestContext> requestCtx, const std::c
     auto envelope = ctx.newOpaqueJSON(rpcNode->schema().module().name(), "output", std::nullopt);
     envelope->insertChild(*responseNode);
 
-    requestCtx->res.write_head(200, {
-                                        contentType(requestCtx->dataFormat.response),
-                                        CORS,
-                                    });
-    requestCtx->res.end(*envelope->printStr(requestCtx->dataFormat.response, libyang::PrintFlags::WithSiblings));
+    sendResponse(requestCtx->res, 200, {contentType(requestCtx->dataFormat.response), CORS}, *envelope->printStr(requestCtx->dataFormat.response, libyang::PrintFlags::WithSiblings));
 }
 
 void processPost(std::shared_ptr<RequestContext> requestCtx, const std::chrono::milliseconds timeout)
@@ -497,19 +516,13 @@ void processPost(std::shared_ptr<RequestContext> requestCtx, const std::chrono::
     requestCtx->res.end();
 }
 
-/** @brief Return the JSON serialization of the value node
- *
- * Parsed ext data (e.g., yang-data container) are opaque nodes. However, in yang-patch we know that these data
- * should conform to a schema. Libyang can not "promote" such nodes to standard data nodes, so we need to serialize
- * them and parse them again.
- */
-std::optional<std::string> yangPatchValueAsJSON(const libyang::DataNode& editContainer)
+/** @brief Return the value node of a YANG patch edit, if any */
+std::optional<libyang::DataNode> yangPatchValue(const libyang::DataNode& editContainer)
 {
     if (auto valueAnyNode = editContainer.findPath("value")) {
         try {
             // if the value is present, we expect it to be a DataNode, not JSON/XML or any other stuff
-            auto valueDataNode = std::get<libyang::DataNode>(valueAnyNode->asAny().releaseValue().value());
-            return *valueDataNode.printStr(libyang::DataFormat::JSON, libyang::PrintFlags::Shrink);
+            return std::get<libyang::DataNode>(valueAnyNode->asAny().releaseValue().value());
         } catch (const std::bad_variant_access&) {
             throw ErrorResponse(400, "protocol", "invalid-value", "Not a data node", valueAnyNode->path());
         }
@@ -518,15 +531,59 @@ std::optional<std::string> yangPatchValueAsJSON(const libyang::DataNode& editCon
     return std::nullopt;
 }
 
-void processYangPatchEdit(const std::shared_ptr<RequestContext>& requestCtx, const libyang::DataNode& editContainer, std::optional<libyang::DataNode>& mergedEdits)
+/** @brief Checks if the parsed value of an edit can be used in the edit as-is
+ *
+ * The value is parsed as an anydata content, i.e., without knowing its parent. Only top-level nodes can be resolved
+ * against the schema in that case, everything else becomes an opaque node. The check also covers what a strict parse
+ * of the request body would reject: there must be a single root and no state data.
+ */
+bool isResolvedTopLevelValue(const libyang::DataNode& value)
+{
+    const auto siblings = value.siblings();
+    if (std::next(siblings.begin()) != siblings.end()) {
+        return false;
+    }
+
+    for (const auto& node : value.childrenDfs()) {
+        if (node.isOpaque() || node.schema().config() == libyang::Config::False) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** @brief Prepare sysrepo edit for a single YANG patch edit
+ *
+ * Parsed ext data (e.g., yang-data container) are opaque nodes unless they can be resolved without their parent.
+ * However, in yang-patch we know that these data should conform to a schema. Libyang can not "promote" such nodes to
+ * standard data nodes, so we need to serialize them and parse them again under the parent node of the target.
+ * Values of top-level targets are already resolved, so they are used directly and skip the round trip.
+ */
+libyang::CreatedNodes createEditForYangPatch(libyang::Context& ctx, const std::string& uriPath, const std::optional<libyang::DataNode>& value)
+{
+    auto [lyParentPath, lastPathSegment] = asLibyangPathSplit(ctx, uriPath);
+
+    if (value && lyParentPath.empty() && isResolvedTopLevelValue(*value)) {
+        validateTopLevelReplacement(*value, lastPathSegment);
+        return {*value, *value};
+    }
+
+    std::optional<std::string> valueStr;
+    if (value) {
+        valueStr = *value->printStr(libyang::DataFormat::JSON, libyang::PrintFlags::Shrink);
+    }
+    return createEditForPutAndPatch(ctx, uriPath, lyParentPath, lastPathSegment, valueStr, libyang::DataFormat::JSON);
+}
+
+void processYangPatchEdit(const std::shared_ptr<RequestContext>& requestCtx, const libyang::Module& netconfMod, const libyang::DataNode& editContainer, std::optional<libyang::DataNode>& mergedEdits)
 {
     auto ctx = requestCtx->sess.getContext();
-    auto netconfMod = *ctx.getModuleImplemented("ietf-netconf");
 
     auto target = childLeafValue(editContainer, "target");
     auto operation = childLeafValue(editContainer, "operation");
 
-    auto [singleEdit, replacementNode] = createEditForPutAndPatch(ctx, requestCtx->req.uri().path + target, yangPatchValueAsJSON(editContainer), libyang::DataFormat::JSON);
+    auto [singleEdit, replacementNode] = createEditForYangPatch(ctx, requestCtx->req.uri().path + target, yangPatchValue(editContainer));
     validateInputMetaAttributes(ctx, *singleEdit);
 
     // insert and move are not defined in RFC6241. sec 7.3 and sysrepo does not support them directly
@@ -564,12 +621,13 @@ void processYangPatchImpl(const std::shared_ptr<RequestContext>& requestCtx, con
 {
     // create one big edit from all the edits because we need to apply all at once.
     std::optional<libyang::DataNode> mergedEdits;
+    const auto netconfMod = *requestCtx->sess.getContext().getModuleImplemented("ietf-netconf");
 
     for (const auto& editContainer : patch.findXPath("edit")) {
         auto editId = childLeafValue(editContainer, "edit-id");
 
         // errors while processing a single edit are reported in the edit-status container
-        WITH_RESTCONF_EXCEPTIONS(processYangPatchEdit, rejectYangPatch(patchId, editId))(requestCtx, editContainer, mergedEdits);
+        WITH_RESTCONF_EXCEPTIONS(processYangPatchEdit, rejectYangPatch(patchId, editId))(requestCtx, netconfMod, editContainer, mergedEdits);
     }
 
     if (mergedEdits) {
@@ -599,8 +657,7 @@ void processYangPatch(std::shared_ptr<RequestContext> requestCtx, const std::chr
     yangPatchStatus->newExtPath("/ietf-yang-patch:yang-patch-status/patch-id", patchId, yangPatchStatusExt);
     yangPatchStatus->newExtPath("/ietf-yang-patch:yang-patch-status/ok", std::nullopt, yangPatchStatusExt);
 
-    requestCtx->res.write_head(200, {contentType(requestCtx->dataFormat.response), CORS});
-    requestCtx->res.end(*yangPatchStatus->printStr(requestCtx->dataFormat.response, libyang::PrintFlags::WithSiblings));
+    sendResponse(requestCtx->res, 200, {contentType(requestCtx->dataFormat.response), CORS}, *yangPatchStatus->printStr(requestCtx->dataFormat.response, libyang::PrintFlags::WithSiblings));
 }
 
 void processPutOrPlainPatch(std::shared_ptr<RequestContext> requestCtx, const std::chrono::milliseconds timeout)
@@ -744,6 +801,191 @@ libyang::PrintFlags libyangPrintFlags(const libyang::DataNode& dataNode, const s
     throw std::logic_error("Invalid withDefaults query parameter value");
 }
 
+/** @brief Selection of (leaf-)list entries as requested by the list pagination query parameters */
+struct ListPagination {
+    std::optional<unsigned> limit;
+    unsigned offset = 0;
+    bool backwards = false;
+    std::optional<std::string> sortBy; /**< path relative to the list entry, "." for the leaf-list entry itself */
+    std::optional<std::string> where;
+};
+
+std::optional<ListPagination> listPagination(const queryParams::QueryParams& params)
+{
+    std::optional<ListPagination> res;
+    auto stringParam = [&params](const std::string& name) -> std::optional<std::string> {
+        if (auto it = params.find(name); it != params.end() && std::get<std::string>(it->second) != "none") {
+            return std::get<std::string>(it->second);
+        }
+        return std::nullopt;
+    };
+
+    for (const auto& [name, value] : params) {
+        if (name == "limit" || name == "offset" || name == "direction" || name == "sort-by" || name == "where") {
+            res = ListPagination{};
+            break;
+        }
+    }
+
+    if (res) {
+        if (auto it = params.find("limit"); it != params.end() && std::holds_alternative<unsigned int>(it->second)) {
+            res->limit = std::get<unsigned int>(it->second);
+        }
+        if (auto it = params.find("offset"); it != params.end()) {
+            res->offset = std::get<unsigned int>(it->second);
+        }
+        if (auto it = params.find("direction"); it != params.end()) {
+            res->backwards = std::holds_alternative<queryParams::direction::Backwards>(it->second);
+        }
+        if (auto it = params.find("sort-by"); it != params.end() && !sortByToPath(it->second).empty()) {
+            res->sortBy = sortByToPath(it->second);
+        }
+        res->where = stringParam("where");
+    }
+
+    return res;
+}
+
+/** @brief Selects the window of (leaf-)list entries as requested by the list pagination, and puts them into the requested order
+ *
+ * Everything is evaluated by libyang on data which were already read through sysrepo, i.e., with NACM applied. Neither
+ * the "where" predicate nor the positions of the entries can therefore reveal anything about entries or nodes which the
+ * user may not read. The entries are reordered by unlinking them and appending them again, one by one. Lists which are
+ * "ordered-by system" might be kept in the order of their keys by libyang no matter what.
+ *
+ * @return The new root of the data tree; the original one might have been a dropped or moved top-level list entry.
+ * The ancestors of the list are kept even if the window has no entries.
+ */
+std::optional<libyang::DataNode> applyListPagination(const libyang::DataNode& data, const std::string& path, const ListPagination& pagination)
+{
+    auto sortKey = [&pagination](const libyang::DataNode& entry) -> std::optional<std::string> {
+        if (*pagination.sortBy == "." || entry.schema().nodeType() == libyang::NodeType::Leaflist) {
+            return entry.asTerm().valueStr();
+        }
+        if (auto node = entry.findPath(*pagination.sortBy); node && node->isTerm()) {
+            return node->asTerm().valueStr();
+        }
+        return std::nullopt;
+    };
+
+    std::set<std::string> selected;
+    if (pagination.where) {
+        for (const auto& entry : data.findXPath(path + "[" + *pagination.where + "]")) {
+            selected.insert(entry.path());
+        }
+    }
+
+    std::set<std::string> entryPaths;
+    std::vector<std::pair<std::optional<std::string>, libyang::DataNode>> entries;
+    std::vector<libyang::DataNode> dropped;
+    for (const auto& entry : data.findXPath(path)) {
+        entryPaths.insert(entry.path());
+        if (pagination.where && !selected.contains(entry.path())) {
+            dropped.push_back(entry);
+        } else {
+            entries.emplace_back(pagination.sortBy ? sortKey(entry) : std::nullopt, entry);
+        }
+    }
+
+    if (pagination.sortBy) {
+        // numerical values are compared as numbers, everything else as strings; entries without the node come last
+        std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            if (!a.first || !b.first) {
+                return a.first.has_value() && !b.first.has_value();
+            }
+
+            char* endA;
+            char* endB;
+            auto numA = std::strtod(a.first->c_str(), &endA);
+            auto numB = std::strtod(b.first->c_str(), &endB);
+            if (!a.first->empty() && !b.first->empty() && *endA == '\0' && *endB == '\0') {
+                return numA < numB;
+            }
+            return *a.first < *b.first;
+        });
+    }
+
+    if (pagination.backwards) {
+        std::reverse(entries.begin(), entries.end());
+    }
+
+    auto begin = std::min<size_t>(pagination.offset, entries.size());
+    auto end = pagination.limit ? std::min<size_t>(begin + *pagination.limit, entries.size()) : entries.size();
+
+    // a top-level node which is not a list entry stays where it is
+    std::optional<libyang::DataNode> root;
+    for (const auto& node : data.siblings()) {
+        if (!entryPaths.contains(node.path())) {
+            root = node;
+            break;
+        }
+    }
+
+    std::optional<libyang::DataNode> parent;
+    if (!entries.empty()) {
+        parent = entries.front().second.parent();
+    } else if (!dropped.empty()) {
+        parent = dropped.front().parent();
+    }
+    for (auto& entry : dropped) {
+        entry.unlink();
+    }
+    for (auto& [key, entry] : entries) {
+        entry.unlink();
+    }
+    for (size_t i = begin; i < end; ++i) {
+        auto& entry = entries[i].second;
+        if (parent) {
+            parent->insertChild(entry);
+        } else if (root) {
+            root->insertSibling(entry);
+        } else {
+            root = entry;
+        }
+    }
+
+    return root;
+}
+
+/** @brief The datastore resource without any data, i.e., the ancestors of a top-level list when a pagination window has no entries */
+libyang::DataNode emptyDatastoreResource(const libyang::Context& ctx)
+{
+    const auto yangApiExt = ctx.getModuleImplemented("ietf-restconf")->extensionInstance("yang-api");
+    auto parent = *ctx.newExtPath("/ietf-restconf:restconf", std::nullopt, yangApiExt);
+    return *parent.newPath("data");
+}
+
+/** @brief Keeps only the nodes selected by the XPath filter, together with their ancestors and descendants
+ *
+ * The filter is evaluated by libyang on data which were already read through sysrepo, i.e., with NACM applied.
+ * Nodes which the user may not read are therefore neither returned nor can they influence the result via predicates.
+ * The filter is intentionally not pushed down into the sysrepo XPath because sysrepo evaluates it before applying NACM.
+ * The whole resource is still fetched, so this saves bandwidth, not the work needed to produce the data.
+ */
+std::optional<libyang::DataNode> filterData(const libyang::DataNode& data, const std::string& xpath)
+{
+    std::optional<libyang::DataNode> res;
+
+    try {
+        for (const auto& node : data.findXPath(xpath)) {
+            auto copy = node.duplicate(libyang::DuplicationOptions::Recursive | libyang::DuplicationOptions::WithParents);
+            while (auto parent = copy.parent()) {
+                copy = *parent;
+            }
+
+            if (!res) {
+                res = copy;
+            } else {
+                res->merge(copy);
+            }
+        }
+    } catch (const libyang::Error& e) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "Invalid filter: "s + e.what());
+    }
+
+    return res;
+}
+
 /* @brief Returns if the request should be treated as a YANG patch request */
 bool isYangPatch(const nghttp2::asio_http2::server::request& req)
 {
@@ -767,11 +1009,59 @@ Server::~Server()
     server->join();
 }
 
-Server::Server(sysrepo::Connection conn, const std::string& address, const std::string& port, const std::chrono::milliseconds timeout)
+Server::OpticsFeed::OpticsFeed(uint64_t lastEventId)
+    : history{1'000, lastEventId}
+{
+}
+
+/** @short The feed of these modules, which is created when needed. Expects `opticsFeedsMtx` to be held. */
+Server::OpticsFeed& Server::opticsFeed(const std::set<std::string>& modules)
+{
+    auto it = opticsFeeds.find(modules);
+    if (it == opticsFeeds.end()) {
+        it = opticsFeeds.try_emplace(modules, newOpticsFeedEventIds()).first;
+    }
+    return it->second;
+}
+
+/** @short The start of a range of event IDs which no feed has used yet. Expects `opticsFeedsMtx` to be held. */
+uint64_t Server::newOpticsFeedEventIds()
+{
+    auto res = opticsFeedEventIds;
+    opticsFeedEventIds += uint64_t{1} << 32;
+    return res;
+}
+
+/** @short Forget the feeds which nobody has listened to for the grace period. Expects `opticsFeedsMtx` to be held.
+ *
+ * Until then, a client which reconnects can still resume from the history of its feed.
+ */
+void Server::pruneOpticsFeeds()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = opticsFeeds.begin(); it != opticsFeeds.end();) {
+        auto& feed = it->second;
+        if (feed.signal.size()) {
+            feed.unusedSince.reset();
+        } else if (!feed.unusedSince) {
+            feed.unusedSince = now;
+        } else if (now - *feed.unusedSince >= opticsGracePeriod) {
+            it = opticsFeeds.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+Server::Server(sysrepo::Connection conn, const std::string& address, const std::string& port, const std::chrono::milliseconds timeout, const EventStreamLimits& streamLimits, const NotificationStreamsConfig& notificationStreams, const OpticsTelemetryConfig& optics)
     : m_monitoringSession(conn.sessionStart(sysrepo::Datastore::Operational))
     , nacm(conn)
+    , notificationDispatcher{std::make_shared<NotificationDispatcher>(conn.sessionStart(), notificationStreams.replayBufferSize)}
+    , onChangeSubscriptions{conn.sessionStart()}
+    , opticsFeedEventIds{uint64_t{std::random_device{}() >> 1} << 32}
+    , opticsGracePeriod{optics.gracePeriod}
+    , dwdmEvents{std::make_shared<sr::OpticalEvents>(conn.sessionStart(), optics.snapshotInterval, optics.dampeningPeriod, optics.gracePeriod)}
     , server{std::make_unique<nghttp2::asio_http2::server::http2>()}
-    , dwdmEvents{std::make_unique<sr::OpticalEvents>(conn.sessionStart())}
 {
     for (const auto& [module, version] : {
              std::pair<std::string, std::string>{"ietf-restconf", "2017-01-26"},
@@ -785,22 +1075,51 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
         }
     }
 
+    validateNotificationStreams(conn.sessionStart().getContext(), notificationStreams);
+
     // set capabilities
     m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[1]", "urn:ietf:params:restconf:capability:defaults:1.0?basic-mode=explicit");
     m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[2]", "urn:ietf:params:restconf:capability:depth:1.0");
     m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[3]", "urn:ietf:params:restconf:capability:with-defaults:1.0");
     m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[4]", "urn:ietf:params:restconf:capability:filter:1.0");
+    m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[5]", "urn:ietf:params:restconf:capability:list-pagination:1.0");
+    m_monitoringSession.setItem("/ietf-restconf-monitoring:restconf-state/capabilities/capability[6]", "urn:ietf:params:restconf:capability:fields:1.0");
     m_monitoringSession.applyChanges();
 
     m_monitoringOperSub = m_monitoringSession.onOperGet(
-        "ietf-restconf-monitoring", [](auto session, auto, auto, auto, auto, auto, auto& parent) {
-            notificationStreamList(session, parent, netconfStreamRoot);
+        "ietf-restconf-monitoring", [notificationStreams, dispatcher = notificationDispatcher](auto session, auto, auto, auto, auto, auto, auto& parent) {
+            notificationStreamList(session, parent, netconfStreamRoot, notificationStreams, *dispatcher);
             return sysrepo::ErrorCode::Ok;
         },
         "/ietf-restconf-monitoring:restconf-state/streams/stream");
 
-    dwdmEvents->change.connect([this](const std::string& content) {
-        opticsChange(as_restconf_push_update(content, std::chrono::system_clock::now()));
+    dwdmEvents->change.connect([this](const sr::OpticalEvents::Update& update) {
+        auto now = std::chrono::system_clock::now();
+        std::optional<std::string> message;
+        std::lock_guard lock{opticsFeedsMtx};
+        pruneOpticsFeeds();
+        for (auto& [modules, feed] : opticsFeeds) {
+            if (!modules.contains(update.module)) {
+                continue;
+            }
+            if ((feed.history.lastId() & 0xffff'ffff) == 0xffff'ffff) {
+                // the next ID would belong to another feed; the clients which reconnect will have to start over
+                feed.history.restart(newOpticsFeedEventIds());
+            }
+            if (!feed.signal.size()) {
+                // not worth serializing for nobody; a client which comes back will have to start over with new snapshots
+                feed.history.skip();
+                continue;
+            }
+            if (update.type == sr::OpticalEvents::Update::Type::Snapshot && modules.size() == 1) {
+                // a client which reconnects can start over from this one, whatever it has missed before
+                feed.history.clear();
+            }
+            if (!message) {
+                message = update.type == sr::OpticalEvents::Update::Type::Snapshot ? yangPushUpdate(update.json, now) : yangPushChangeUpdate(update.json, now);
+            }
+            feed.signal(feed.history.push(*message));
+        }
     });
 
     server->handle("/", [](const auto& req, const auto& res) {
@@ -813,21 +1132,222 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
     server->handle("/.well-known/host-meta", [](const auto& req, const auto& res) {
         const auto& peer = http::peer_from_request(req);
         spdlog::info("{}: {} {}", peer, req.method(), req.uri().raw_path);
-        res.write_head(
-                   200,
-                   {
-                       contentType("application/xrd+xml"),
-                       CORS,
-                   });
-        res.end("<XRD xmlns='http://docs.oasis-open.org/ns/xri/xrd-1.0'><Link rel='restconf' href='"s + restconfRoot + "'></XRD>"s);
+        sendResponse(res, 200, {contentType("application/xrd+xml"), CORS}, "<XRD xmlns='http://docs.oasis-open.org/ns/xri/xrd-1.0'><Link rel='restconf' href='"s + restconfRoot + "'></XRD>"s);
+    });
+
+    server->handle("/telemetry/optics", [this, limits = streamLimits.optics, keepalive = streamLimits.keepalive](const auto& req, const auto& res) {
+        OpticsTelemetryRequest request;
+        try {
+            request = asOpticsTelemetryRequest(dwdmEvents->modules(), req.uri().raw_query);
+        } catch (const ErrorResponse& e) {
+            sendResponse(res, e.code, {TEXT_PLAIN, CORS}, e.errorMessage);
+            return;
+        }
+
+        // each selected module starts with a snapshot of its own; expects `opticsFeedsMtx` to be held
+        auto snapshots = [this, modules = request.modules](const std::map<std::string, sr::OpticalEvents::Data>& data) {
+            auto now = std::chrono::system_clock::now();
+            std::vector<http::EventPtr> events;
+            for (const auto& [module, json] : data) {
+                events.emplace_back(http::makeEvent(yangPushUpdate(*json, now), opticsFeed(modules).history.lastId()));
+            }
+            return events;
+        };
+
+        std::optional<http::RateLimit> rateLimit;
+        if (request.maxRate) {
+            // a patch which is not sent would leave the client with inconsistent data, so it gets fresh snapshots instead
+            rateLimit = http::RateLimit{.interval = rateInterval(*request.maxRate), .latest = [this, modules = request.modules, snapshots]() {
+                std::vector<http::EventPtr> events;
+                dwdmEvents->withCurrentData(modules, [&](const auto& data) {
+                    std::lock_guard lock{opticsFeedsMtx};
+                    events = snapshots(data);
+                });
+                return events;
+            }};
+        }
+
+        // sysrepo is only watched while there are some clients; starting that blocks, see OpticalEvents::subscribe(),
+        // so it is done off the I/O thread. The request and the response are only valid until the stream is closed.
+        auto closed = std::make_shared<bool>(false);
+        res.on_close([closed](auto) { *closed = true; });
+        boost::asio::post(blockingWork, [this, &io = res.io_service(), &req, &res, closed, request, rateLimit, snapshots, limits, keepalive]() {
+            std::shared_ptr<void> subscription;
+            try {
+                subscription = dwdmEvents->subscribe();
+            } catch (const sysrepo::ErrorWithCode& e) {
+                spdlog::error("Optics telemetry: cannot watch sysrepo: {}", e.what());
+                boost::asio::post(io, [&res, closed]() {
+                    if (!*closed) {
+                        sendResponse(res, 500, {TEXT_PLAIN, CORS}, "Internal server error due to sysrepo exception.");
+                    }
+                });
+                return;
+            }
+
+            boost::asio::post(io, [this, &req, &res, closed, request, rateLimit, snapshots, limits, keepalive, subscription]() {
+                if (*closed) {
+                    return;
+                }
+                // the client starts with a snapshot; no patch must get lost before it subscribes to further changes
+                dwdmEvents->withCurrentData(request.modules, [&](const auto& data) {
+                    // clients which have picked the same modules share the events, including the history for those which reconnect
+                    std::lock_guard lock{opticsFeedsMtx};
+                    pruneOpticsFeeds();
+                    auto& feed = opticsFeed(request.modules);
+                    std::optional<std::vector<http::EventPtr>> initialEvents;
+                    if (auto lastId = http::lastEventId(req.header())) {
+                        // a client which reconnects gets just what it has missed, if that is still available;
+                        // an ID of another feed (or of a feed which has been forgotten) is not known in this one
+                        initialEvents = feed.history.after(*lastId);
+                    }
+                    if (!initialEvents) {
+                        initialEvents = snapshots(data);
+                    }
+                    auto client = std::make_shared<SubscriptionStream>(req, res, feed.signal, subscription, *initialEvents, http::DeliveryOptions{
+                        .limits = limits,
+                        .counters = streamStatistics.counters(req.uri().path),
+                        .keepalive = keepalive,
+                        .batching = std::nullopt,
+                        .rateLimit = rateLimit,
+                    });
+                    client->activate();
+                });
+            });
+        });
+    });
+
+    server->handle("/telemetry/periodic", [this, conn, limits = streamLimits.periodic, keepalive = streamLimits.keepalive](const auto& req, const auto& res) mutable {
+        auto sess = conn.sessionStart();
+
+        if (req.method() == "OPTIONS") {
+            res.write_head(200, {CORS, ALLOW_GET_HEAD_OPTIONS});
+            res.end();
+            return;
+        }
+
+        try {
+            authorizeRequest(nacm, sess, req);
+
+            if (req.method() != "GET" && req.method() != "HEAD") {
+                throw ErrorResponse(405, "application", "operation-not-supported", "Method not allowed.");
+            }
+
+            auto key = asPeriodicSubscription(sess.getContext(), req.uri().raw_query);
+            key.user = sess.getNacmUser();
+            auto subscription = periodicSubscriptions.subscribe(sess, key);
+            std::vector<http::EventPtr> initialEvents;
+            if (auto update = subscription->currentUpdate()) {
+                initialEvents.emplace_back(std::move(*update));
+            }
+            auto client = std::make_shared<SubscriptionStream>(req, res, subscription->signal, subscription, initialEvents, http::DeliveryOptions{
+                .limits = limits,
+                .counters = streamStatistics.counters(req.uri().path),
+                .keepalive = keepalive,
+                .batching = std::nullopt,
+                .rateLimit = std::nullopt,
+            });
+            client->activate();
+        } catch (const auth::Error& e) {
+            processAuthError(req, res, e, [&res]() {
+                sendResponse(res, 401, {TEXT_PLAIN, CORS}, "Access denied.");
+            });
+        } catch (const ErrorResponse& e) {
+            nghttp2::asio_http2::header_map headers = {TEXT_PLAIN, CORS};
+
+            if (e.code == 405) {
+                headers.emplace(decltype(headers)::value_type ALLOW_GET_HEAD_OPTIONS);
+            }
+
+            sendResponse(res, e.code, std::move(headers), e.errorMessage);
+        }
+    });
+
+    server->handle("/telemetry/on-change", [this, conn, limits = streamLimits.onChange, keepalive = streamLimits.keepalive](const auto& req, const auto& res) mutable {
+        auto sess = conn.sessionStart();
+
+        if (req.method() == "OPTIONS") {
+            res.write_head(200, {CORS, ALLOW_GET_HEAD_OPTIONS});
+            res.end();
+            return;
+        }
+
+        try {
+            authorizeRequest(nacm, sess, req);
+
+            if (req.method() != "GET" && req.method() != "HEAD") {
+                throw ErrorResponse(405, "application", "operation-not-supported", "Method not allowed.");
+            }
+
+            auto [key, modules] = asOnChangeSubscription(sess.getContext(), req.uri().raw_query);
+            key.user = sess.getNacmUser();
+            auto subscription = onChangeSubscriptions.subscribe(key, modules);
+            // the client starts with the complete data; no patch must get lost before it subscribes to further changes
+            subscription->withCurrentData(sess, [&](const std::string& data) {
+                auto client = std::make_shared<SubscriptionStream>(req, res, subscription->signal, subscription, std::vector{http::makeEvent(yangPushUpdate(data, std::chrono::system_clock::now()))}, http::DeliveryOptions{
+                    .limits = limits,
+                    .counters = streamStatistics.counters(req.uri().path),
+                    .keepalive = keepalive,
+                    .batching = std::nullopt,
+                    .rateLimit = std::nullopt,
+                });
+                client->activate();
+            });
+        } catch (const auth::Error& e) {
+            processAuthError(req, res, e, [&res]() {
+                sendResponse(res, 401, {TEXT_PLAIN, CORS}, "Access denied.");
+            });
+        } catch (const ErrorResponse& e) {
+            nghttp2::asio_http2::header_map headers = {TEXT_PLAIN, CORS};
+
+            if (e.code == 405) {
+                headers.emplace(decltype(headers)::value_type ALLOW_GET_HEAD_OPTIONS);
+            }
+
+            sendResponse(res, e.code, std::move(headers), e.errorMessage);
+        }
     });
 
-    server->handle("/telemetry/optics", [this](const auto& req, const auto& res) {
-        auto client = std::make_shared<http::EventStream>(req, res, opticsChange, as_restconf_push_update(dwdmEvents->currentData(), std::chrono::system_clock::now()));
-        client->activate();
+    server->handle("/telemetry/statistics", [this, conn](const auto& req, const auto& res) mutable {
+        const auto& peer = http::peer_from_request(req);
+        spdlog::info("{}: {} {}", peer, req.method(), req.uri().raw_path);
+        auto sess = conn.sessionStart(sysrepo::Datastore::Operational);
+
+        if (req.method() == "OPTIONS") {
+            res.write_head(200, {CORS, ALLOW_GET_HEAD_OPTIONS});
+            res.end();
+            return;
+        }
+
+        try {
+            authorizeRequest(nacm, sess, req);
+
+            if (req.method() != "GET" && req.method() != "HEAD") {
+                throw ErrorResponse(405, "application", "operation-not-supported", "Method not allowed.");
+            }
+
+            // the statistics describe the event streams, so they are available to those who may read the list of streams
+            if (!sess.getData("/ietf-restconf-monitoring:restconf-state/streams", 1)) {
+                throw ErrorResponse(403, "application", "access-denied", "Access denied.");
+            }
+
+            sendResponse(res, 200, {contentType("application/json"), CORS}, streamStatistics.asJSON());
+        } catch (const auth::Error& e) {
+            processAuthError(req, res, e, [&res]() {
+                sendResponse(res, 401, {TEXT_PLAIN, CORS}, "Access denied.");
+            });
+        } catch (const ErrorResponse& e) {
+            nghttp2::asio_http2::header_map headers = {TEXT_PLAIN, CORS};
+
+            if (e.code == 405) {
+                headers.emplace(decltype(headers)::value_type ALLOW_GET_HEAD_OPTIONS);
+            }
+
+            sendResponse(res, e.code, std::move(headers), e.errorMessage);
+        }
     });
 
-    server->handle(netconfStreamRoot, [this, conn](const auto& req, const auto& res) mutable {
+    server->handle(netconfStreamRoot, [this, conn, limits = streamLimits.notifications, keepalive = streamLimits.keepalive, notificationStreams](const auto& req, const auto& res) mutable {
         auto sess = conn.sessionStart();
         libyang::DataFormat dataFormat;
         std::optional<std::string> xpathFilter;
@@ -844,6 +1364,10 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
             authorizeRequest(nacm, sess, req);
 
             auto streamRequest = asRestconfStreamRequest(req.method(), req.uri().path, req.uri().raw_query);
+            auto stream = findNotificationStream(sess.getContext(), notificationStreams, *notificationDispatcher, streamRequest.name);
+            if (!stream) {
+                throw ErrorResponse(404, "application", "invalid-value", "Invalid stream");
+            }
 
             switch(streamRequest.type) {
             case RestconfStreamRequest::Type::NetconfNotificationJSON:
@@ -868,15 +1392,43 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
                 stopTime = libyang::fromYangTimeFormat<std::chrono::system_clock>(std::get<std::string>(it->second));
             }
 
+            std::optional<http::Batching> batching;
+            if (auto it = streamRequest.queryParams.find("rousette-batch-size"); it != streamRequest.queryParams.end()) {
+                batching.emplace().maxEvents = std::get<unsigned int>(it->second);
+            }
+            if (auto it = streamRequest.queryParams.find("rousette-batch-window"); it != streamRequest.queryParams.end()) {
+                if (!batching) {
+                    batching.emplace();
+                }
+                batching->window = std::chrono::milliseconds{std::get<unsigned int>(it->second)};
+            }
+            std::optional<http::RateLimit> rateLimit;
+            if (auto it = streamRequest.queryParams.find("rousette-max-rate"); it != streamRequest.queryParams.end()) {
+                // each notification is different, so those beyond the rate are simply dropped
+                rateLimit = http::RateLimit{.interval = rateInterval(std::get<unsigned int>(it->second)), .latest = nullptr};
+            }
+
             // The signal is constructed outside NotificationStream class because it is required to be passed to
             // NotificationStream's parent (EventStream) constructor where it already must be constructed
             // Yes, this is a hack.
-            auto client = std::make_shared<NotificationStream>(req, res, std::make_shared<rousette::http::EventStream::Signal>(), sess, dataFormat, xpathFilter, startTime, stopTime);
+            auto client = std::make_shared<NotificationStream>(req, res, std::make_shared<rousette::http::EventStream::Signal>(), sess, NotificationSubscription{
+                .stream = *stream,
+                .dataFormat = dataFormat,
+                .filter = xpathFilter,
+                .startTime = startTime,
+                .stopTime = stopTime,
+                .lastEventId = http::lastEventId(req.header()),
+            }, notificationDispatcher, http::DeliveryOptions{
+                .limits = limits,
+                .counters = streamStatistics.counters(req.uri().path),
+                .keepalive = keepalive,
+                .batching = batching,
+                .rateLimit = rateLimit,
+            });
             client->activate();
         } catch (const auth::Error& e) {
             processAuthError(req, res, e, [&res]() {
-                res.write_head(401, {TEXT_PLAIN, CORS});
-                res.end("Access denied.");
+                sendResponse(res, 401, {TEXT_PLAIN, CORS}, "Access denied.");
             });
         } catch (const ErrorResponse& e) {
             // RFC does not specify how the errors should look like so let's just report the HTTP code and print the error message
@@ -886,8 +1438,7 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
                 headers.emplace(decltype(headers)::value_type ALLOW_GET_HEAD_OPTIONS);
             }
 
-            res.write_head(e.code, headers);
-            res.end(e.errorMessage);
+            sendResponse(res, e.code, std::move(headers), e.errorMessage);
         }
     });
 
@@ -907,22 +1458,19 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
             authorizeRequest(nacm, sess, req);
 
             if (auto mod = asYangModule(sess.getContext(), req.uri().path); mod && hasAccessToYangSchema(sess, *mod)) {
-                res.write_head(
-                    200,
-                    {
-                        contentType("application/yang"),
-                        CORS,
-                    });
-                res.end(std::visit([](auto&& arg) { return arg.printStr(libyang::SchemaOutputFormat::Yang); }, *mod));
+                if (req.method() == "HEAD") {
+                    res.write_head(200, {contentType("application/yang"), CORS});
+                    res.end();
+                } else {
+                    sendResponse(res, 200, {contentType("application/yang"), CORS}, std::visit([](auto&& arg) { return arg.printStr(libyang::SchemaOutputFormat::Yang); }, *mod));
+                }
                 return;
             } else {
-                res.write_head(404, {TEXT_PLAIN, CORS});
-                res.end("YANG schema not found");
+                sendResponse(res, 404, {TEXT_PLAIN, CORS}, "YANG schema not found");
             }
         } catch (const auth::Error& e) {
             processAuthError(req, res, e, [&res]() {
-                res.write_head(401, {TEXT_PLAIN, CORS});
-                res.end("Access denied.");
+                sendResponse(res, 401, {TEXT_PLAIN, CORS}, "Access denied.");
             });
         }
     });
@@ -947,8 +1495,7 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
                 case RestconfRequest::Type::RestconfRoot:
                 case RestconfRequest::Type::YangLibraryVersion:
                 case RestconfRequest::Type::ListRPC:
-                    res.write_head(200, {contentType(dataFormat.response), CORS});
-                    res.end(*apiResource(sess.getContext(), restconfRequest.type).printStr(dataFormat.response, libyang::PrintFlags::WithSiblings | libyang::PrintFlags::KeepEmptyCont));
+                    sendResponse(res, 200, {contentType(dataFormat.response), CORS}, *apiResource(sess.getContext(), restconfRequest.type).printStr(dataFormat.response, libyang::PrintFlags::WithSiblings | libyang::PrintFlags::KeepEmptyCont));
                     break;
 
                 case RestconfRequest::Type::GetData: {
@@ -973,18 +1520,60 @@ Server::Server(sysrepo::Connection conn, const std::string& address, const std::
                         }
                     }
 
-                    if (auto data = sess.getData(restconfRequest.path, maxDepth, getOptions, timeout); data) {
-                        res.write_head(
-                            200,
-                            {
-                                contentType(dataFormat.response),
-                                CORS,
-                            });
+                    auto pagination = listPagination(restconfRequest.queryParams);
+                    auto xpath = restconfRequest.path;
+
+                    // HEAD only needs to know whether the data exist, unless some nodes are selected only after the fetch
+                    const bool headOnly = req.method() == "HEAD" && !restconfRequest.queryParams.contains("rousette-filter") && !(pagination && restconfRequest.queryParams.contains("fields"));
+                    if (headOnly) {
+                        maxDepth = 1;
+                    }
+
+                    // only the requested nodes are fetched, so sysrepo does not even invoke oper callbacks for the rest;
+                    // the pagination counts whole entries and it might need other nodes for "where" and "sort-by", though,
+                    // so a paginated list is fetched whole and the fields are selected afterwards
+                    std::optional<std::string> fieldsFilter;
+                    if (auto it = restconfRequest.queryParams.find("fields"); it != restconfRequest.queryParams.end()) {
+                        auto fieldsXPath = fieldsToXPath(xpath, std::get<queryParams::fields::Expr>(it->second));
+                        if (pagination) {
+                            fieldsFilter = fieldsXPath;
+                        } else {
+                            xpath = fieldsXPath;
+                        }
+                    }
+
+                    auto data = sess.getData(xpath, maxDepth, getOptions, timeout);
 
+                    // a window past the end of the list is not an error, the client gets the list's ancestors without any entries
+                    auto emptyWindow = false;
+                    if (data && pagination && !headOnly) {
+                        data = applyListPagination(*data, restconfRequest.path, *pagination);
+                        emptyWindow = !data || data->findXPath(restconfRequest.path).empty();
+                        if (!data) {
+                            data = emptyDatastoreResource(sess.getContext());
+                        }
+                    }
+
+                    if (data && fieldsFilter && !emptyWindow) {
+                        data = filterData(*data, *fieldsFilter);
+                    }
+
+                    if (auto it = restconfRequest.queryParams.find("rousette-filter"); data && it != restconfRequest.queryParams.end()) {
+                        data = filterData(*data, std::get<std::string>(it->second));
+                    }
+
+                    if (data && headOnly) {
+                        res.write_head(200, {contentType(dataFormat.response), CORS});
+                        res.end();
+                    } else if (data) {
                         auto urlPrefix = http::parseUrlPrefix(req.header());
                         data = replaceYangLibraryLocations(urlPrefix, yangSchemaRoot, *data);
                         data = replaceStreamLocations(urlPrefix, *data);
-                        res.end(*data->printStr(dataFormat.response, libyangPrintFlags(*data, restconfRequest.path, withDefaults)));
+                        auto printFlags = libyangPrintFlags(*data, restconfRequest.path, withDefaults);
+                        if (emptyWindow) {
+                            printFlags = printFlags | libyang::PrintFlags::KeepEmptyCont;
+                        }
+                        sendResponse(res, 200, {contentType(dataFormat.response), CORS}, *data->printStr(dataFormat.response, printFlags));
                     } else {
                         throw ErrorResponse(404, "application", "invalid-value", "No data from sysrepo.");
                     }
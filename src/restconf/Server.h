@@ -6,10 +6,14 @@
 */
 
 #pragma once
+#include <boost/asio/thread_pool.hpp>
+#include <mutex>
 #include <sysrepo-cpp/Connection.hpp>
 #include <sysrepo-cpp/Subscription.hpp>
 #include "auth/Nacm.h"
 #include "http/EventStream.h"
+#include "restconf/NotificationStream.h"
+#include "restconf/YangPush.h"
 
 namespace nghttp2::asio_http2::server {
 class http2;
@@ -25,20 +29,72 @@ namespace restconf {
 
 std::optional<std::string> as_subtree_path(const std::string& path);
 
+/** @short Per-client queue limits of the event streams */
+struct EventStreamLimits {
+    /** @short NETCONF notifications, where each event matters */
+    http::QueueLimits notifications{10'000, 16 * 1024 * 1024, http::OverflowPolicy::DropOldest};
+    /** @short Optics telemetry, where a client which missed a patch has to reconnect to get a new snapshot */
+    http::QueueLimits optics{1'000, 4 * 1024 * 1024, http::OverflowPolicy::Disconnect};
+    /** @short Periodic yang-push subscriptions, where only the most recent contents matter */
+    http::QueueLimits periodic{1, 0, http::OverflowPolicy::CoalesceLatest};
+    /** @short On-change yang-push subscriptions, where a client which missed a patch has to reconnect */
+    http::QueueLimits onChange{1'000, 4 * 1024 * 1024, http::OverflowPolicy::Disconnect};
+    /** @short Heartbeats and reaping of stalled clients, for all of the above */
+    http::Keepalive keepalive;
+};
+
+/** @short On-change telemetry of the optical parameters */
+struct OpticsTelemetryConfig {
+    /** @short How often to send complete data, so that the clients can resynchronize; zero disables that */
+    std::chrono::seconds snapshotInterval{60};
+    /** @short Changes within this period are coalesced into a single update, like the dampening-period of RFC 8641 */
+    std::chrono::milliseconds dampeningPeriod{0};
+    /** @short How long to keep watching the data after the last client has disconnected */
+    std::chrono::seconds gracePeriod{30};
+};
+
 /** @short A RESTCONF-ish server */
 class Server {
 public:
-    explicit Server(sysrepo::Connection conn, const std::string& address, const std::string& port, const std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
+    explicit Server(sysrepo::Connection conn, const std::string& address, const std::string& port, const std::chrono::milliseconds timeout = std::chrono::milliseconds{0}, const EventStreamLimits& streamLimits = {}, const NotificationStreamsConfig& notificationStreams = {}, const OpticsTelemetryConfig& optics = {});
     ~Server();
 
 private:
     sysrepo::Session m_monitoringSession;
     std::optional<sysrepo::Subscription> m_monitoringOperSub;
     auth::Nacm nacm;
+    std::shared_ptr<NotificationDispatcher> notificationDispatcher;
+    PeriodicSubscriptions periodicSubscriptions;
+    OnChangeSubscriptions onChangeSubscriptions;
+    /** @short Optics telemetry of some modules, shared by all clients which have picked the same ones */
+    struct OpticsFeed {
+        explicit OpticsFeed(uint64_t lastEventId);
+        http::EventStream::Signal signal;
+        /** @short Recent events, so that a client which reconnects does not need new snapshots */
+        http::EventHistory history;
+        /** @short When the last client went away, as far as anybody has noticed */
+        std::optional<std::chrono::steady_clock::time_point> unusedSince;
+    };
+    std::mutex opticsFeedsMtx; // for `opticsFeeds` and `opticsFeedEventIds`
+    /** @short Feeds for each set of modules which some client has asked for */
+    std::map<std::set<std::string>, OpticsFeed> opticsFeeds;
+    /** @short Each feed gets its own range of event IDs, so that an ID from another feed is never mistaken for its own
+     *
+     * A range is 2^32 IDs. A feed which runs out of its range moves on to a new one.
+     */
+    uint64_t opticsFeedEventIds;
+    std::chrono::seconds opticsGracePeriod;
+    std::shared_ptr<sr::OpticalEvents> dwdmEvents;
+    http::StreamStatistics streamStatistics;
+    // The clients of the event streams refer to the members above, and these clients only go away along with the server.
+    // That is why the server has to be destroyed first.
     std::unique_ptr<nghttp2::asio_http2::server::http2> server;
-    std::unique_ptr<sr::OpticalEvents> dwdmEvents;
-    using JsonDiffSignal = boost::signals2::signal<void(const std::string& json)>;
-    JsonDiffSignal opticsChange;
+    /** @short Work which would block the I/O threads for too long; it is done or dropped before the server goes away */
+    boost::asio::thread_pool blockingWork{1};
+
+    OpticsFeed& opticsFeed(const std::set<std::string>& modules);
+    uint64_t newOpticsFeedEventIds();
+    void pruneOpticsFeeds();
 };
 }
 }
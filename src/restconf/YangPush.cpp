@@ -0,0 +1,490 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include <algorithm>
+#include <libyang-cpp/Time.hpp>
+#include <spdlog/spdlog.h>
+#include "restconf/Exceptions.h"
+#include "restconf/YangPush.h"
+#include "restconf/uri.h"
+#include "sr/OpticalEvents.h"
+
+using namespace std::string_literals;
+
+namespace {
+constexpr auto notifPrefix = R"json({"ietf-restconf:notification":{"eventTime":")json";
+constexpr auto notifMid = R"json(","ietf-yang-push:push-update":{"datastore-contents":)json";
+constexpr auto notifSuffix = R"json(}}})json";
+constexpr auto notifChangeMid = R"json(","ietf-yang-push:push-change-update":{"datastore-changes":{"yang-patch":)json";
+constexpr auto notifChangeSuffix = R"json(}}}})json";
+
+constexpr auto minimalPeriod = std::chrono::milliseconds{10};
+
+/** @short The first multiple of the period which comes after the given time */
+std::chrono::steady_clock::time_point alignedAfter(const std::chrono::steady_clock::time_point& time, const std::chrono::milliseconds& period)
+{
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch());
+    return std::chrono::steady_clock::time_point{(sinceEpoch / period + 1) * period};
+}
+
+void tick(rousette::restconf::PeriodicSubscriptions::Subscription& sub)
+{
+    if (auto event = sub.currentUpdate()) {
+        sub.signal(*event);
+    }
+}
+
+sysrepo::Datastore datastoreFromIdentity(const std::string& identity)
+{
+    if (identity == "ietf-datastores:running") {
+        return sysrepo::Datastore::Running;
+    } else if (identity == "ietf-datastores:operational") {
+        return sysrepo::Datastore::Operational;
+    } else if (identity == "ietf-datastores:candidate") {
+        return sysrepo::Datastore::Candidate;
+    } else if (identity == "ietf-datastores:startup") {
+        return sysrepo::Datastore::Startup;
+    } else if (identity == "ietf-datastores:factory-default") {
+        return sysrepo::Datastore::FactoryDefault;
+    }
+
+    throw rousette::restconf::ErrorResponse(400, "application", "operation-failed", "Unsupported datastore " + identity);
+}
+
+/** @short Remembers the paths of the node and of all of its descendants */
+void addSubtree(std::set<std::string>& paths, const libyang::DataNode& node)
+{
+    for (const auto& n : node.childrenDfs()) {
+        paths.emplace(n.path());
+    }
+}
+
+/** @short Forgets the path of the node and the paths of all of its descendants */
+void eraseSubtree(std::set<std::string>& paths, const std::string& path)
+{
+    paths.erase(path);
+    const auto prefix = path + '/';
+    for (auto it = paths.lower_bound(prefix); it != paths.end() && it->starts_with(prefix);) {
+        it = paths.erase(it);
+    }
+}
+
+/** @short Is the node, or one of its ancestors, among the nodes (identified by their paths)? */
+bool isSelfOrWithin(const libyang::DataNode& node, const std::set<std::string>& paths)
+{
+    for (std::optional<libyang::DataNode> n = node; n; n = n->parent()) {
+        if (paths.contains(n->path())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @short Names of modules whose data can be selected by the XPath; there must be some */
+std::set<std::string> selectedModules(const libyang::Context& ctx, const std::string& xpath)
+{
+    std::set<std::string> modules;
+    try {
+        for (const auto& node : ctx.findXPath(xpath)) {
+            auto top = node;
+            while (top.parent()) {
+                top = *top.parent();
+            }
+            modules.emplace(top.module().name());
+        }
+    } catch (const libyang::Error&) {
+        // reported just like an XPath which does not select anything
+    }
+
+    if (modules.empty()) {
+        throw rousette::restconf::ErrorResponse(400, "application", "invalid-argument", "XPath \"" + xpath + "\" does not select any data.");
+    }
+    return modules;
+}
+}
+
+namespace rousette::restconf {
+
+/** @brief Wraps the data with a yang-push push-update notification */
+std::string yangPushUpdate(const std::string& content, const std::chrono::system_clock::time_point& time)
+{
+    return notifPrefix + libyang::yangTimeFormat(time, libyang::TimezoneInterpretation::Local) + notifMid + content + notifSuffix;
+}
+
+/** @brief Wraps a YANG Patch with a yang-push push-change-update notification */
+std::string yangPushChangeUpdate(const std::string& yangPatch, const std::chrono::system_clock::time_point& time)
+{
+    return notifPrefix + libyang::yangTimeFormat(time, libyang::TimezoneInterpretation::Local) + notifChangeMid + yangPatch + notifChangeSuffix;
+}
+
+PeriodicSubscriptions::Subscription::Subscription(const Key& key, sysrepo::Session session, const std::chrono::steady_clock::time_point& nextTick)
+    : key(key)
+    , nextTick(nextTick)
+    , m_session(std::move(session))
+{
+    m_session.switchDatastore(key.datastore);
+}
+
+/** @brief A push-update with the data as they are now, or nullopt if these cannot be retrieved */
+std::optional<http::EventPtr> PeriodicSubscriptions::Subscription::currentUpdate()
+{
+    try {
+        std::lock_guard lock{m_sessionMtx};
+        auto data = m_session.getData(key.xpath);
+        auto content = data ? *data->printStr(libyang::DataFormat::JSON, libyang::PrintFlags::WithSiblings) : "{}"s;
+        return http::makeEvent(yangPushUpdate(content, std::chrono::system_clock::now()));
+    } catch (const std::exception& e) {
+        spdlog::warn("Periodic subscription for {}: {}", key.xpath, e.what());
+        return std::nullopt;
+    }
+}
+
+PeriodicSubscriptions::PeriodicSubscriptions()
+    : m_thread([this](std::stop_token stop) { run(stop); })
+{
+}
+
+/** @brief Returns a subscription for the key, either an existing one, or a new one which uses the session
+ *
+ * The session must have the NACM user from the key already set.
+ */
+std::shared_ptr<PeriodicSubscriptions::Subscription> PeriodicSubscriptions::subscribe(sysrepo::Session session, const Key& key)
+{
+    std::lock_guard lock{m_mtx};
+    auto& weak = m_subscriptions[key];
+    if (auto sub = weak.lock()) {
+        return sub;
+    }
+
+    auto sub = std::make_shared<Subscription>(key, std::move(session), alignedAfter(std::chrono::steady_clock::now(), key.period));
+    weak = sub;
+    m_changed = true;
+    m_cv.notify_one();
+    return sub;
+}
+
+void PeriodicSubscriptions::run(std::stop_token stop)
+{
+    std::unique_lock lock{m_mtx};
+    while (!stop.stop_requested()) {
+        std::optional<std::chrono::steady_clock::time_point> next;
+        for (auto it = m_subscriptions.begin(); it != m_subscriptions.end();) {
+            if (auto sub = it->second.lock()) {
+                next = next ? std::min(*next, sub->nextTick) : sub->nextTick;
+                ++it;
+            } else {
+                it = m_subscriptions.erase(it);
+            }
+        }
+
+        m_changed = false;
+        if (!next) {
+            m_cv.wait(lock, stop, [this] { return m_changed; });
+            continue;
+        }
+        if (m_cv.wait_until(lock, stop, *next, [this] { return m_changed; }) || stop.stop_requested()) {
+            // a new subscription might be due earlier
+            continue;
+        }
+
+        std::vector<std::shared_ptr<Subscription>> due;
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& [key, weak] : m_subscriptions) {
+            if (auto sub = weak.lock(); sub && sub->nextTick <= now) {
+                sub->nextTick = alignedAfter(now, key.period);
+                due.emplace_back(std::move(sub));
+            }
+        }
+
+        lock.unlock();
+        for (const auto& sub : due) {
+            tick(*sub);
+        }
+        due.clear();
+        lock.lock();
+    }
+}
+
+/** @brief Parses and validates the query string of a request for a periodic subscription
+ *
+ * The NACM user is not filled in.
+ */
+PeriodicSubscriptions::Key asPeriodicSubscription(const libyang::Context& ctx, const std::string& queryString)
+{
+    PeriodicSubscriptions::Key key{.xpath = {}, .datastore = sysrepo::Datastore::Operational, .period = {}, .user = std::nullopt};
+    auto params = asTelemetryQueryParams(queryString, {"xpath", "period", "datastore"});
+
+    if (!params.contains("xpath") || !params.contains("period")) {
+        throw ErrorResponse(400, "protocol", "missing-attribute", "Query parameters \"xpath\" and \"period\" are required");
+    }
+    key.xpath = std::get<std::string>(params.at("xpath"));
+    key.period = std::chrono::milliseconds{std::get<unsigned int>(params.at("period"))};
+    if (auto it = params.find("datastore"); it != params.end()) {
+        key.datastore = datastoreFromIdentity(std::get<std::string>(it->second));
+    }
+    if (key.period < minimalPeriod) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "The period must be at least " + std::to_string(minimalPeriod.count()) + " ms");
+    }
+
+    selectedModules(ctx, key.xpath);
+    return key;
+}
+
+OnChangeSubscriptions::Subscription::Subscription(const Key& key, sysrepo::Session session, const std::set<std::string>& modules)
+    : key(key)
+    , modules(modules)
+    , m_session(std::move(session))
+{
+    m_session.switchDatastore(key.datastore);
+    if (key.user) {
+        m_session.setNacmUser(*key.user);
+    }
+
+    if (auto data = m_session.getData(key.xpath)) {
+        for (const auto& sibling : data->siblings()) {
+            addSubtree(m_sent, sibling);
+        }
+    }
+}
+
+/** @brief Invoke the callback with the data which the patches follow up on, so that no patch slips in between
+ *
+ * The data are read with the client's own @p session, which has the NACM user of this subscription.
+ */
+void OnChangeSubscriptions::Subscription::withCurrentData(sysrepo::Session session, const std::function<void(const std::string& json)>& cb)
+{
+    std::lock_guard lock{m_mtx};
+    session.switchDatastore(key.datastore);
+    auto data = session.getData(key.xpath);
+    cb(data ? *data->printStr(libyang::DataFormat::JSON, libyang::PrintFlags::WithSiblings) : "{}"s);
+}
+
+/** @brief Send a patch with those changes which this subscription can see
+ *
+ * Created and modified nodes are visible if the NACM user can read them now, their values are taken from that read.
+ * Deleted nodes are visible if they have been sent before.
+ */
+void OnChangeSubscriptions::Subscription::onChange(const std::vector<sr::DataChange>& changes)
+{
+    std::lock_guard lock{m_mtx};
+
+    // the reported changes come with their ancestors, which is enough for selecting the subtree
+    std::set<std::string> selected;
+    for (const auto& node : changes.front().node.findXPath(key.xpath)) {
+        selected.emplace(node.path());
+    }
+
+    std::set<std::string> present;
+    for (const auto& [operation, node] : changes) {
+        if (operation != sysrepo::ChangeOperation::Deleted && isSelfOrWithin(node, selected)) {
+            present.emplace(node.path());
+        }
+    }
+
+    // descendants of a node are read along with it
+    std::string xpath;
+    for (const auto& [operation, node] : changes) {
+        if (auto parent = node.parent(); present.contains(node.path()) && !(parent && isSelfOrWithin(*parent, present))) {
+            xpath += (xpath.empty() ? "" : " | ") + node.path();
+        }
+    }
+    auto current = xpath.empty() ? std::nullopt : m_session.getData(xpath);
+
+    std::vector<sr::DataChange> visible;
+    for (const auto& [operation, node] : changes) {
+        auto path = node.path();
+        if (operation == sysrepo::ChangeOperation::Deleted) {
+            if (m_sent.contains(path)) {
+                visible.push_back({operation, node});
+                eraseSubtree(m_sent, path);
+            }
+        } else if (auto readable = (current && present.contains(path)) ? current->findPath(path) : std::nullopt) {
+            visible.push_back({operation, *readable});
+            addSubtree(m_sent, *readable);
+        }
+    }
+
+    if (!visible.empty()) {
+        auto patch = sr::asYangPatch(std::to_string(++m_lastPatchId), visible);
+        signal(http::makeEvent(yangPushChangeUpdate(patch, std::chrono::system_clock::now())));
+    }
+}
+
+OnChangeSubscriptions::OnChangeSubscriptions(sysrepo::Session session)
+    : m_session(std::move(session))
+    , m_thread([this](std::stop_token stop) { run(stop); })
+{
+}
+
+/** @brief Returns a subscription for the key, either an existing one, or a new one
+ *
+ * A new subscription reads the data with a session of its own, which gets the NACM user from the key. Sysrepo
+ * subscriptions are only made for those modules and datastores which some client needs.
+ */
+std::shared_ptr<OnChangeSubscriptions::Subscription> OnChangeSubscriptions::subscribe(const Key& key, const std::set<std::string>& modules)
+{
+    std::lock_guard lock{m_mtx};
+
+    if (auto it = m_subscriptions.find(key); it != m_subscriptions.end()) {
+        if (auto sub = it->second.subscription.lock()) {
+            return sub;
+        }
+    }
+
+    // subscribe before retrieving the initial data so that no change is lost
+    for (const auto& module : modules) {
+        if (!m_srSubscriptions.contains({module, key.datastore})) {
+            sysrepo::ModuleChangeCb cb = [this](auto sess, auto, auto name, auto, auto, auto) {
+                onChange(sess, std::string{name});
+                return sysrepo::ErrorCode::Ok;
+            };
+            m_session.switchDatastore(key.datastore);
+            m_srSubscriptions.emplace(std::pair{module, key.datastore}, m_session.onModuleChange(module, cb, std::nullopt, 0, sysrepo::SubscribeOptions::DoneOnly | sysrepo::SubscribeOptions::Passive));
+            spdlog::debug("On-change subscriptions: listening for module {}", module);
+        }
+    }
+
+    // the last client to go away might do so from within a sysrepo callback, so the cleanup is left to run()
+    auto sub = std::shared_ptr<Subscription>(new Subscription(key, m_session.getConnection().sessionStart(), modules), [this](Subscription* sub) {
+        delete sub;
+        std::lock_guard lock{m_mtx};
+        m_released = true;
+        m_cv.notify_one();
+    });
+    m_subscriptions[key] = {sub, modules};
+    return sub;
+}
+
+/** @brief Forgets about the released subscriptions, and drops those sysrepo subscriptions which are not needed anymore
+ *
+ * This must not lock the weak pointers; if such a pointer was the last one, the deleter would try to take the mutex again.
+ */
+void OnChangeSubscriptions::run(std::stop_token stop)
+{
+    std::unique_lock lock{m_mtx};
+    while (!stop.stop_requested()) {
+        if (!m_cv.wait(lock, stop, [this] { return m_released; })) {
+            continue;
+        }
+        m_released = false;
+
+        std::erase_if(m_subscriptions, [](const auto& entry) { return entry.second.subscription.expired(); });
+
+        // unsubscribing waits for the running callbacks which need the mutex, so do that only after it is released
+        std::vector<sysrepo::Subscription> unused;
+        for (auto it = m_srSubscriptions.begin(); it != m_srSubscriptions.end();) {
+            const auto& [module, datastore] = it->first;
+            auto needed = std::ranges::any_of(m_subscriptions, [&](const auto& entry) {
+                return entry.first.datastore == datastore && entry.second.modules.contains(module);
+            });
+            if (needed) {
+                ++it;
+            } else {
+                spdlog::debug("On-change subscriptions: not listening for module {} anymore", module);
+                unused.emplace_back(std::move(it->second));
+                it = m_srSubscriptions.erase(it);
+            }
+        }
+
+        lock.unlock();
+        unused.clear();
+        lock.lock();
+    }
+}
+
+void OnChangeSubscriptions::onChange(sysrepo::Session session, const std::string& module)
+{
+    std::vector<sr::DataChange> changes;
+    for (const auto& ch : session.getChanges()) {
+        changes.push_back({ch.operation, ch.node});
+    }
+    if (changes.empty()) {
+        return;
+    }
+
+    // when a client goes away meanwhile, its subscription is released right here, so the mutex must not be held by then
+    std::vector<std::shared_ptr<Subscription>> interested;
+    {
+        std::lock_guard lock{m_mtx};
+        for (const auto& [key, entry] : m_subscriptions) {
+            if (key.datastore != session.activeDatastore() || !entry.modules.contains(module)) {
+                continue;
+            }
+            if (auto sub = entry.subscription.lock()) {
+                interested.emplace_back(std::move(sub));
+            }
+        }
+    }
+
+    for (const auto& sub : interested) {
+        try {
+            sub->onChange(changes);
+        } catch (const std::exception& e) {
+            spdlog::warn("On-change subscription for {}: {}", sub->key.xpath, e.what());
+        }
+    }
+}
+
+/** @brief Parses and validates the query string of a request for an on-change subscription
+ *
+ * The NACM user is not filled in.
+ *
+ * @return The subscription, and names of the modules which it watches
+ */
+std::pair<OnChangeSubscriptions::Key, std::set<std::string>> asOnChangeSubscription(const libyang::Context& ctx, const std::string& queryString)
+{
+    OnChangeSubscriptions::Key key{.xpath = {}, .datastore = sysrepo::Datastore::Operational, .user = std::nullopt};
+    auto params = asTelemetryQueryParams(queryString, {"xpath", "datastore"});
+
+    if (!params.contains("xpath")) {
+        throw ErrorResponse(400, "protocol", "missing-attribute", "Query parameter \"xpath\" is required");
+    }
+    key.xpath = std::get<std::string>(params.at("xpath"));
+    if (auto it = params.find("datastore"); it != params.end()) {
+        key.datastore = datastoreFromIdentity(std::get<std::string>(it->second));
+        if (key.datastore == sysrepo::Datastore::FactoryDefault) {
+            throw ErrorResponse(400, "application", "operation-failed", "The factory-default datastore never changes");
+        }
+    }
+
+    return {key, selectedModules(ctx, key.xpath)};
+}
+
+/** @brief Parses the query string of a request for the optics telemetry
+ *
+ * A client can limit the number of events per second, and pick just some of the @p availableModules.
+ */
+OpticsTelemetryRequest asOpticsTelemetryRequest(const std::set<std::string>& availableModules, const std::string& queryString)
+{
+    OpticsTelemetryRequest request{.maxRate = std::nullopt, .modules = availableModules};
+    auto params = asTelemetryQueryParams(queryString, {"rousette-max-rate", "modules"});
+
+    if (auto it = params.find("rousette-max-rate"); it != params.end()) {
+        request.maxRate = std::get<unsigned int>(it->second);
+    }
+    if (auto it = params.find("modules"); it != params.end()) {
+        request.modules.clear();
+        for (const auto& module : std::get<queryParams::modules::Names>(it->second)) {
+            if (!availableModules.contains(module)) {
+                throw ErrorResponse(400, "protocol", "invalid-value", "Module \"" + module + "\" is not available for optics telemetry");
+            }
+            request.modules.emplace(module);
+        }
+    }
+
+    return request;
+}
+
+SubscriptionStream::SubscriptionStream(const nghttp2::asio_http2::server::request& req,
+                                       const nghttp2::asio_http2::server::response& res,
+                                       Signal& signal,
+                                       std::shared_ptr<void> subscription,
+                                       const std::vector<http::EventPtr>& initialEvents,
+                                       const http::DeliveryOptions& options)
+    : EventStream(req, res, signal, initialEvents, options)
+    , m_subscription(std::move(subscription))
+{
+}
+}
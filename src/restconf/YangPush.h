@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sysrepo-cpp/Session.hpp>
+#include <sysrepo-cpp/Subscription.hpp>
+#include <thread>
+#include "http/EventStream.h"
+#include "sr/OpticalEvents.h"
+
+namespace rousette::restconf {
+
+std::string yangPushUpdate(const std::string& content, const std::chrono::system_clock::time_point& time);
+std::string yangPushChangeUpdate(const std::string& yangPatch, const std::chrono::system_clock::time_point& time);
+
+/** @brief Periodic yang-push subscriptions (RFC 8641), each of them sending a subtree of a datastore every so often
+ *
+ * Clients which ask for the same subtree of the same datastore with the same period, and which share the NACM user, share
+ * a single subscription. The data are retrieved and serialized just once for all of them.
+ *
+ * All subscriptions are served by a single thread. The ticks are aligned to the multiples of their period, so that
+ * subscriptions with the same (or a commensurable) period are served within a single wakeup. A newly connected client
+ * should start with the currentUpdate() instead of waiting for the next tick.
+ */
+class PeriodicSubscriptions {
+public:
+    struct Key {
+        std::string xpath;
+        sysrepo::Datastore datastore;
+        std::chrono::milliseconds period;
+        /** @short NACM user; the data are filtered by NACM */
+        std::optional<std::string> user;
+
+        auto operator<=>(const Key&) const = default;
+    };
+
+    /** @short A subscription shared by several clients; it is active as long as somebody holds it */
+    struct Subscription {
+        Subscription(const Key& key, sysrepo::Session session, const std::chrono::steady_clock::time_point& nextTick);
+        std::optional<http::EventPtr> currentUpdate();
+
+        const Key key;
+        http::EventStream::Signal signal;
+        std::chrono::steady_clock::time_point nextTick;
+
+    private:
+        std::mutex m_sessionMtx; // the session is used both by the ticks and by the newly connected clients
+        sysrepo::Session m_session;
+    };
+
+    PeriodicSubscriptions();
+    std::shared_ptr<Subscription> subscribe(sysrepo::Session session, const Key& key);
+
+private:
+    std::mutex m_mtx; // for `m_subscriptions`, `m_changed`, and `nextTick` of all subscriptions
+    std::map<Key, std::weak_ptr<Subscription>> m_subscriptions;
+    bool m_changed = false;
+    std::condition_variable_any m_cv;
+    std::jthread m_thread;
+
+    void run(std::stop_token stop);
+};
+
+PeriodicSubscriptions::Key asPeriodicSubscription(const libyang::Context& ctx, const std::string& queryString);
+
+/** @brief On-change yang-push subscriptions (RFC 8641), each of them sending changes of a subtree of a datastore
+ *
+ * There is at most one sysrepo subscription for each (module, datastore) pair, no matter how many clients are interested.
+ * Clients which ask for the same subtree of the same datastore and share the NACM user share a single subscription.
+ *
+ * The patches are built from the changes which sysrepo reports. The XPath is evaluated on these changes, so it should
+ * not depend on unchanged values. The changes are not filtered by NACM, so each subscription reads the changed nodes
+ * with its NACM user, and it remembers which nodes it has already sent so that it reports just their deletion.
+ *
+ * Subscriptions which are not needed anymore are released, along with their sysrepo subscriptions, by a thread of
+ * their own. A client can go away in the middle of a sysrepo callback, and a sysrepo subscription cannot be dropped
+ * from its own callback.
+ */
+class OnChangeSubscriptions {
+public:
+    struct Key {
+        std::string xpath;
+        sysrepo::Datastore datastore;
+        /** @short NACM user; the data are filtered by NACM */
+        std::optional<std::string> user;
+
+        auto operator<=>(const Key&) const = default;
+    };
+
+    /** @short A subscription shared by several clients; it is active as long as somebody holds it */
+    class Subscription {
+    public:
+        Subscription(const Key& key, sysrepo::Session session, const std::set<std::string>& modules);
+        void withCurrentData(sysrepo::Session session, const std::function<void(const std::string& json)>& cb);
+        void onChange(const std::vector<sr::DataChange>& changes);
+
+        const Key key;
+        /** @short Modules whose changes are relevant */
+        const std::set<std::string> modules;
+        http::EventStream::Signal signal;
+
+    private:
+        std::mutex m_mtx;
+        sysrepo::Session m_session;
+        /** @short Paths of the nodes which the clients know about */
+        std::set<std::string> m_sent;
+        uint64_t m_lastPatchId = 0;
+    };
+
+    explicit OnChangeSubscriptions(sysrepo::Session session);
+    std::shared_ptr<Subscription> subscribe(const Key& key, const std::set<std::string>& modules);
+
+private:
+    std::mutex m_mtx; // for `m_subscriptions`, `m_srSubscriptions` and `m_released`
+    sysrepo::Session m_session;
+    struct Entry {
+        std::weak_ptr<Subscription> subscription;
+        /** @short A copy of the subscription's modules, so that these can be checked without locking the weak_ptr */
+        std::set<std::string> modules;
+    };
+    std::map<Key, Entry> m_subscriptions;
+    std::map<std::pair<std::string, sysrepo::Datastore>, sysrepo::Subscription> m_srSubscriptions;
+    bool m_released = false;
+    std::condition_variable_any m_cv;
+    std::jthread m_thread;
+
+    void onChange(sysrepo::Session session, const std::string& module);
+    void run(std::stop_token stop);
+};
+
+std::pair<OnChangeSubscriptions::Key, std::set<std::string>> asOnChangeSubscription(const libyang::Context& ctx, const std::string& queryString);
+
+/** @short What a client of the optics telemetry wants to get */
+struct OpticsTelemetryRequest {
+    /** @short At most this many events per second */
+    std::optional<unsigned> maxRate;
+    /** @short Modules to report; all available ones unless the client has picked some */
+    std::set<std::string> modules;
+};
+
+OpticsTelemetryRequest asOpticsTelemetryRequest(const std::set<std::string>& availableModules, const std::string& queryString);
+
+/** @brief An event stream which keeps a shared subscription alive for as long as the client is connected */
+class SubscriptionStream : public http::EventStream {
+    std::shared_ptr<void> m_subscription;
+
+public:
+    SubscriptionStream(const nghttp2::asio_http2::server::request& req,
+                       const nghttp2::asio_http2::server::response& res,
+                       Signal& signal,
+                       std::shared_ptr<void> subscription,
+                       const std::vector<http::EventPtr>& initialEvents,
+                       const http::DeliveryOptions& options);
+};
+}
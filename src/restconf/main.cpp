@@ -27,11 +27,22 @@
 static const char usage[] =
   R"(Rousette - RESTCONF server
 Usage:
-  rousette [--syslog] [--timeout <SECONDS>] [--help]
+  rousette [--syslog] [--timeout <SECONDS>] [--stream-max-events <N>] [--stream-max-bytes <BYTES>] [--stream-overflow <POLICY>] [--stream-heartbeat <SECONDS>] [--stream-stall-timeout <SECONDS>] [--module-streams] [--stream <NAME=XPATH>]... [--replay-buffer <N>] [--optics-snapshot-interval <SECONDS>] [--optics-dampening <MILLISECONDS>] [--optics-grace-period <SECONDS>] [--help]
 Options:
   -h --help                         Show this screen.
   -t --timeout <SECONDS>            Change default timeout in sysrepo (if not set, use sysrepo internal).
   --syslog                          Log to syslog.
+  --stream-max-events <N>           Maximal number of notifications queued for a single client, 0 for no limit [default: 10000].
+  --stream-max-bytes <BYTES>        Maximal size of notifications queued for a single client, 0 for no limit [default: 16777216].
+  --stream-overflow <POLICY>        What to do with a client which does not keep up: drop-oldest, coalesce or disconnect [default: drop-oldest].
+  --stream-heartbeat <SECONDS>      Send a comment to an idle event stream this often, 0 to disable [default: 30].
+  --stream-stall-timeout <SECONDS>  Disconnect an event stream client which has not read anything for this long, 0 to disable [default: 120].
+  --module-streams                  Provide a notification stream for each YANG module which defines some notifications.
+  --stream <NAME=XPATH>             Provide a notification stream NAME with notifications selected by XPATH.
+  --replay-buffer <N>               Number of recent notifications kept in memory to serve replays, 0 to always use sysrepo [default: 1000].
+  --optics-snapshot-interval <SECONDS>  How often to send complete optics telemetry in addition to the changes, 0 for never [default: 60].
+  --optics-dampening <MILLISECONDS>  Coalesce changes of optics telemetry and send them at most once per this period [default: 0].
+  --optics-grace-period <SECONDS>   How long to keep watching optics data after the last telemetry client has disconnected [default: 30].
 )";
 #ifdef HAVE_SYSTEMD
 
@@ -80,6 +91,35 @@ int main(int argc, char* argv [])
     if (args["--timeout"]) {
         timeout = std::chrono::milliseconds{args["--timeout"].asLong() * 1000};
     }
+
+    rousette::restconf::EventStreamLimits streamLimits;
+    streamLimits.notifications.maxEvents = args["--stream-max-events"].asLong();
+    streamLimits.notifications.maxBytes = args["--stream-max-bytes"].asLong();
+    if (const auto& policy = args["--stream-overflow"].asString(); policy == "drop-oldest") {
+        streamLimits.notifications.policy = rousette::http::OverflowPolicy::DropOldest;
+    } else if (policy == "coalesce") {
+        streamLimits.notifications.policy = rousette::http::OverflowPolicy::CoalesceLatest;
+    } else if (policy == "disconnect") {
+        streamLimits.notifications.policy = rousette::http::OverflowPolicy::Disconnect;
+    } else {
+        throw std::invalid_argument("Invalid --stream-overflow policy: " + policy);
+    }
+    streamLimits.keepalive.heartbeat = std::chrono::seconds{args["--stream-heartbeat"].asLong()};
+    streamLimits.keepalive.stallTimeout = std::chrono::seconds{args["--stream-stall-timeout"].asLong()};
+    rousette::restconf::NotificationStreamsConfig notificationStreams;
+    notificationStreams.perModule = args["--module-streams"].asBool();
+    for (const auto& stream : args["--stream"].asStringList()) {
+        auto eq = stream.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument("Invalid --stream, expected NAME=XPATH: " + stream);
+        }
+        notificationStreams.filtered.emplace(stream.substr(0, eq), stream.substr(eq + 1));
+    }
+    notificationStreams.replayBufferSize = args["--replay-buffer"].asLong();
+    rousette::restconf::OpticsTelemetryConfig optics;
+    optics.snapshotInterval = std::chrono::seconds{args["--optics-snapshot-interval"].asLong()};
+    optics.dampeningPeriod = std::chrono::milliseconds{args["--optics-dampening"].asLong()};
+    optics.gracePeriod = std::chrono::seconds{args["--optics-grace-period"].asLong()};
     if (args["--syslog"].asBool()) {
         auto syslog_sink = std::make_shared<spdlog::sinks::syslog_sink_mt>("rousette", LOG_PID, LOG_USER, true);
         auto logger = std::make_shared<spdlog::logger>("rousette", syslog_sink);
@@ -105,7 +145,7 @@ int main(int argc, char* argv [])
     }
 
     auto conn = sysrepo::Connection{};
-    auto server = rousette::restconf::Server{conn, "::1", "10080", timeout};
+    auto server = rousette::restconf::Server{conn, "::1", "10080", timeout, streamLimits, notificationStreams, optics};
     signal(SIGTERM, [](int) {});
     signal(SIGINT, [](int) {});
     pause();
@@ -4,6 +4,7 @@
  * Written by Tomáš Pecka <tomas.pecka@cesnet.cz>
  */
 
+#include <array>
 #include <boost/fusion/include/std_pair.hpp>
 #include <experimental/iterator>
 #include <libyang-cpp/Enum.hpp>
@@ -112,6 +113,20 @@ struct insertTable: x3::symbols<queryParams::QueryParamValue> {
     }
 } const insertParam;
 
+struct directionTable: x3::symbols<queryParams::QueryParamValue> {
+    directionTable()
+    {
+    add
+        ("forwards", queryParams::direction::Forwards{})
+        ("backwards", queryParams::direction::Backwards{});
+    }
+} const directionParam;
+
+auto validLimitValues = [](auto& ctx) {
+    _val(ctx) = _attr(ctx);
+    _pass(ctx) = _attr(ctx) > 0;
+};
+
 // early sanity check, this timestamp will be parsed by libyang::fromYangTimeFormat anyways
 const auto dateAndTime = x3::rule<class dateAndTime, std::string>{"dateAndTime"} =
     x3::repeat(4)[x3::digit] >> x3::char_('-') >> x3::repeat(2)[x3::digit] >> x3::char_('-') >> x3::repeat(2)[x3::digit] >> x3::char_('T') >>
@@ -119,6 +134,17 @@ const auto dateAndTime = x3::rule<class dateAndTime, std::string>{"dateAndTime"}
     (x3::char_('Z') | (-(x3::char_('+')|x3::char_('-')) >> x3::repeat(2)[x3::digit] >> x3::char_(':') >> x3::repeat(2)[x3::digit]));
 const auto filter = x3::rule<class filter, std::string>{"filter"} = +(urlEncodedChar | (x3::char_ - '&'));
 const auto depthParam = x3::rule<class depthParam, queryParams::QueryParamValue>{"depthParam"} = x3::uint_[validDepthValues] | (x3::string("unbounded") >> x3::attr(queryParams::UnboundedDepth{}));
+// RFC 8040, sec. 4.8.3; an item with a nested expression can also be followed by another item
+const x3::rule<class fieldsExpr, queryParams::fields::Expr> fieldsExpr = "fieldsExpr";
+const auto fieldsItem = x3::rule<class fieldsItem, queryParams::fields::Field>{"fieldsItem"} = (apiIdentifier % '/') >> (('(' >> fieldsExpr >> ')') | x3::attr(queryParams::fields::Expr{}));
+const auto fieldsExpr_def = fieldsItem % ';';
+BOOST_SPIRIT_DEFINE(fieldsExpr);
+
+const auto limitParam = x3::rule<class limitParam, queryParams::QueryParamValue>{"limitParam"} = x3::uint_[validLimitValues] | (x3::string("unbounded") >> x3::attr(queryParams::limit::Unbounded{}));
+const auto positiveNumber = x3::rule<class positiveNumber, unsigned int>{"positiveNumber"} = x3::uint_[validLimitValues];
+const auto sortByPath = x3::rule<class sortByPath, queryParams::sortBy::Path>{"sortByPath"} = apiIdentifier % '/';
+const auto sortByParam = x3::rule<class sortByParam, queryParams::QueryParamValue>{"sortByParam"} = (x3::lit('.') >> x3::attr(queryParams::sortBy::Self{})) | sortByPath;
+const auto moduleList = x3::rule<class moduleList, queryParams::modules::Names>{"moduleList"} = moduleName % ',';
 const auto queryParamPair = x3::rule<class queryParamPair, std::pair<std::string, queryParams::QueryParamValue>>{"queryParamPair"} =
         (x3::string("depth") >> "=" >> depthParam) |
         (x3::string("with-defaults") >> "=" >> withDefaultsParam) |
@@ -126,8 +152,22 @@ const auto queryParamPair = x3::rule<class queryParamPair, std::pair<std::string
         (x3::string("insert") >> "=" >> insertParam) |
         (x3::string("point") >> "=" >> uriPath) |
         (x3::string("filter") >> "=" >> filter) |
+        (x3::string("rousette-filter") >> "=" >> filter) |
+        (x3::string("fields") >> "=" >> fieldsExpr) |
         (x3::string("start-time") >> "=" >> dateAndTime) |
-        (x3::string("stop-time") >> "=" >> dateAndTime);
+        (x3::string("stop-time") >> "=" >> dateAndTime) |
+        (x3::string("limit") >> "=" >> limitParam) |
+        (x3::string("offset") >> "=" >> x3::uint_) |
+        (x3::string("direction") >> "=" >> directionParam) |
+        (x3::string("sort-by") >> "=" >> sortByParam) |
+        (x3::string("where") >> "=" >> filter) |
+        (x3::string("rousette-batch-size") >> "=" >> positiveNumber) |
+        (x3::string("rousette-batch-window") >> "=" >> positiveNumber) |
+        (x3::string("rousette-max-rate") >> "=" >> positiveNumber) |
+        (x3::string("xpath") >> "=" >> filter) |
+        (x3::string("datastore") >> "=" >> filter) |
+        (x3::string("period") >> "=" >> positiveNumber) |
+        (x3::string("modules") >> "=" >> moduleList);
 
 const auto queryParamGrammar = x3::rule<class grammar, queryParams::QueryParams>{"queryParamGrammar"} = queryParamPair % "&" | x3::eps;
 
@@ -370,6 +410,9 @@ void validateMethodForNode(const std::string& httpMethod, const impl::URIPrefix&
     }
 }
 
+/** @brief Query parameters from draft-ietf-netconf-list-pagination-rc which apply to a targeted list or leaf-list */
+constexpr std::array listPaginationParameters{"limit", "offset", "direction", "sort-by", "where"};
+
 void validateQueryParameters(const std::multimap<std::string, queryParams::QueryParamValue>& params_, const std::string& httpMethod)
 {
     std::map<std::string, queryParams::QueryParamValue> params;
@@ -380,7 +423,7 @@ void validateQueryParameters(const std::multimap<std::string, queryParams::Query
         }
     }
 
-    for (const auto& param : {"depth", "with-defaults", "content"}) {
+    for (const auto& param : {"depth", "with-defaults", "content", "fields", "rousette-filter", "limit", "offset", "direction", "sort-by", "where"}) {
         if (auto it = params.find(param); it != params.end() && httpMethod != "GET" && httpMethod != "HEAD") {
             throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '"s + param + "' can be used only with GET and HEAD methods");
         }
@@ -392,12 +435,18 @@ void validateQueryParameters(const std::multimap<std::string, queryParams::Query
         }
     }
 
-    for (const auto& param : {"filter", "start-time", "stop-time"}) {
+    for (const auto& param : {"filter", "start-time", "stop-time", "rousette-batch-size", "rousette-batch-window", "rousette-max-rate"}) {
         if (auto it = params.find(param); it != params.end()) {
             throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '"s + param + "' can be used only with streams");
         }
     }
 
+    for (const auto& param : {"xpath", "datastore", "period", "modules"}) {
+        if (auto it = params.find(param); it != params.end()) {
+            throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '"s + param + "' can be used only with telemetry");
+        }
+    }
+
     {
         auto itInsert = params.find("insert");
         auto itPoint = params.find("point");
@@ -419,12 +468,160 @@ void validateQueryParametersForStream(const std::multimap<std::string, queryPara
             throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '" + k + "' already specified");
         }
 
-        if (k != "filter" && k != "start-time" && k != "stop-time") {
+        if (k != "filter" && k != "start-time" && k != "stop-time" && k != "rousette-batch-size" && k != "rousette-batch-window" && k != "rousette-max-rate") {
             throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '" + k + "' can't be used with streams");
         }
     }
 }
 
+bool hasListPaginationParameters(const queryParams::QueryParams& params)
+{
+    return std::any_of(listPaginationParameters.begin(), listPaginationParameters.end(), [&params](const auto& param) { return params.contains(param); });
+}
+
+/** @brief Checks that the list pagination parameters target a whole list or leaf-list
+ *
+ * @throws ErrorResponse if the target is not a list or a leaf-list, or if a single entry is requested
+ */
+void validateListPaginationTarget(const std::optional<libyang::SchemaNode>& node, const std::vector<PathSegment>& segments)
+{
+    if (!node || (node->nodeType() != libyang::NodeType::List && node->nodeType() != libyang::NodeType::Leaflist) || !segments.back().keys.empty()) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "List pagination query parameters can be used only with a list or a leaf-list target");
+    }
+}
+
+/** @brief Checks that the "where" query parameter is a single predicate of the target list
+ *
+ * The value ends up within brackets after the path of the list, and it is evaluated by libyang on the data which were
+ * already read with NACM applied. It must not close these brackets, nor make a union with some other node set, otherwise
+ * it could select data from anywhere else. Its syntax is then checked by libyang.
+ *
+ * @throws ErrorResponse if the value is not a valid predicate
+ */
+void validateListPaginationWhere(const libyang::Context& ctx, const std::string& listPath, const std::string& where)
+{
+    auto error = ErrorResponse(400, "protocol", "invalid-value", "Query parameter 'where' is not a valid XPath predicate");
+
+    std::vector<char> brackets;
+    std::optional<char> quote;
+    for (const auto c : where) {
+        if (quote) {
+            if (c == *quote) {
+                quote.reset();
+            }
+            continue;
+        }
+
+        switch (c) {
+        case '\'':
+        case '"':
+            quote = c;
+            break;
+        case '(':
+        case '[':
+            brackets.push_back(c);
+            break;
+        case ')':
+        case ']':
+            if (brackets.empty() || brackets.back() != (c == ')' ? '(' : '[')) {
+                throw error;
+            }
+            brackets.pop_back();
+            break;
+        case '|':
+            if (brackets.empty()) {
+                throw error;
+            }
+            break;
+        }
+    }
+    if (quote || !brackets.empty()) {
+        throw error;
+    }
+
+    try {
+        ctx.findXPath(listPath + "[" + where + "]");
+    } catch (const libyang::Error&) {
+        throw error;
+    }
+}
+
+void fieldsToXPath(const std::string& prefix, const queryParams::fields::Expr& expr, std::vector<std::string>& out)
+{
+    for (const auto& field : expr) {
+        auto path = prefix;
+        for (const auto& apiIdent : field.path) {
+            path += "/" + apiIdentName(apiIdent);
+        }
+
+        if (field.children.empty()) {
+            out.emplace_back(std::move(path));
+        } else {
+            fieldsToXPath(path, field.children, out);
+        }
+    }
+}
+
+bool isSortByNone(const queryParams::QueryParamValue& sortBy)
+{
+    return sortBy == queryParams::QueryParamValue{queryParams::sortBy::Path{ApiIdentifier{"none"}}};
+}
+
+/** @brief Checks that the "sort-by" query parameter refers to a single leaf in each entry of the target list, or to the entry itself for a leaf-list
+ *
+ * @throws ErrorResponse if the value does not refer to such a node
+ */
+void validateListPaginationSortBy(const libyang::Context& ctx, const libyang::SchemaNode& node, const std::string& listPath, const queryParams::QueryParamValue& sortBy)
+{
+    if (isSortByNone(sortBy)) {
+        return;
+    }
+
+    if (std::holds_alternative<queryParams::sortBy::Self>(sortBy)) {
+        if (node.nodeType() != libyang::NodeType::Leaflist) {
+            throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter 'sort-by' can be '.' only for a leaf-list");
+        }
+        return;
+    }
+
+    auto error = ErrorResponse(400, "protocol", "invalid-value", "Query parameter 'sort-by' does not refer to a leaf of the list entries");
+    if (node.nodeType() != libyang::NodeType::List) {
+        throw error;
+    }
+
+    try {
+        auto nodes = ctx.findXPath(listPath + "/" + sortByToPath(sortBy));
+        if (nodes.size() != 1 || nodes.front().nodeType() != libyang::NodeType::Leaf) {
+            throw error;
+        }
+    } catch (const libyang::Error&) {
+        throw error;
+    }
+}
+
+/** @brief Checks that each path of the "fields" query parameter refers to a schema node below the target
+ *
+ * The XPath generated by fieldsToXPath() is then safe to be handed over to sysrepo.
+ *
+ * @throws ErrorResponse if some path of the expression does not refer to any schema node
+ */
+void validateFields(const libyang::Context& ctx, const std::string& path, const queryParams::fields::Expr& expr)
+{
+    std::vector<std::string> paths;
+    fieldsToXPath(path, expr, paths);
+
+    for (const auto& fieldPath : paths) {
+        auto error = ErrorResponse(400, "protocol", "invalid-value", "Query parameter 'fields' refers to '" + fieldPath + "' which is not a schema node");
+        try {
+            if (ctx.findXPath(fieldPath).empty()) {
+                throw error;
+            }
+        } catch (const libyang::Error&) {
+            throw error;
+        }
+    }
+}
+
 /** @brief Wrapper for a libyang path and a corresponding SchemaNode. SchemaNode is nullopt for datastore resource */
 struct SchemaNodeAndPath {
     std::string dataPath;
@@ -432,10 +629,11 @@ struct SchemaNodeAndPath {
 };
 
 /** @brief Translates PathSegment sequence to a path understood by libyang
+ * @param allowWholeListTarget Whether the last segment may refer to a whole (leaf-)list, i.e., without any keys
  * @return libyang path to a data node
  * @throws ErrorResponse On invalid URI which can mean that, e.g, a node is not found, wrong number of list keys provided, list key could not be properly escaped.
  */
-SchemaNodeAndPath asLibyangPath(const libyang::Context& ctx, const std::vector<PathSegment>::const_iterator& begin, const std::vector<PathSegment>::const_iterator& end)
+SchemaNodeAndPath asLibyangPath(const libyang::Context& ctx, const std::vector<PathSegment>::const_iterator& begin, const std::vector<PathSegment>::const_iterator& end, const bool allowWholeListTarget = false)
 {
     std::optional<libyang::SchemaNode> currentNode;
     std::string res;
@@ -455,7 +653,9 @@ SchemaNodeAndPath asLibyangPath(const libyang::Context& ctx, const std::vector<P
 
         res += "/" + maybeQualified(*currentNode);
 
-        if (currentNode->nodeType() == libyang::NodeType::List) {
+        if (allowWholeListTarget && std::next(it) == end && it->keys.empty() && (currentNode->nodeType() == libyang::NodeType::List || currentNode->nodeType() == libyang::NodeType::Leaflist)) {
+            // all the list entries are requested
+        } else if (currentNode->nodeType() == libyang::NodeType::List) {
             const auto& listKeys = currentNode->asList().keys();
 
             if (listKeys.size() == 0) {
@@ -531,8 +731,21 @@ RestconfRequest asRestconfRequest(const libyang::Context& ctx, const std::string
     }
     validateQueryParameters(*queryParameters, httpMethod);
 
-    auto [lyPath, schemaNode] = asLibyangPath(ctx, uri->segments.begin(), uri->segments.end());
+    const auto listPagination = hasListPaginationParameters(*queryParameters);
+    auto [lyPath, schemaNode] = asLibyangPath(ctx, uri->segments.begin(), uri->segments.end(), listPagination);
     validateMethodForNode(httpMethod, uri->prefix, schemaNode);
+    if (listPagination) {
+        validateListPaginationTarget(schemaNode, uri->segments);
+        if (auto it = queryParameters->find("where"); it != queryParameters->end() && std::get<std::string>(it->second) != "none") {
+            validateListPaginationWhere(ctx, lyPath, std::get<std::string>(it->second));
+        }
+        if (auto it = queryParameters->find("sort-by"); it != queryParameters->end()) {
+            validateListPaginationSortBy(ctx, *schemaNode, lyPath, it->second);
+        }
+    }
+    if (auto it = queryParameters->find("fields"); it != queryParameters->end()) {
+        validateFields(ctx, uri->segments.empty() ? "" : lyPath, std::get<queryParams::fields::Expr>(it->second));
+    }
 
     auto path = uri->segments.empty() ? "/" : lyPath;
     RestconfRequest::Type type;
@@ -609,16 +822,23 @@ std::optional<std::variant<libyang::Module, libyang::SubmoduleParsed>> asYangMod
 
 RestconfStreamRequest asRestconfStreamRequest(const std::string& httpMethod, const std::string& uriPath, const std::string& uriQueryString)
 {
-    static const auto netconfStreamRoot = "/streams/NETCONF/";
+    static const auto streamsRoot = "/streams/"s;
     RestconfStreamRequest::Type type;
 
     if (httpMethod != "GET" && httpMethod != "HEAD") {
         throw ErrorResponse(405, "application", "operation-not-supported", "Method not allowed.");
     }
 
-    if (uriPath == netconfStreamRoot + "XML"s) {
+    // /streams/<name>/<encoding>
+    auto nameEnd = uriPath.find('/', streamsRoot.size());
+    if (!uriPath.starts_with(streamsRoot) || nameEnd == std::string::npos || nameEnd == streamsRoot.size()) {
+        throw ErrorResponse(404, "application", "invalid-value", "Invalid stream");
+    }
+    auto name = uriPath.substr(streamsRoot.size(), nameEnd - streamsRoot.size());
+
+    if (auto encoding = uriPath.substr(nameEnd + 1); encoding == "XML") {
         type = RestconfStreamRequest::Type::NetconfNotificationXML;
-    } else if (uriPath == netconfStreamRoot + "JSON"s) {
+    } else if (encoding == "JSON") {
         type = RestconfStreamRequest::Type::NetconfNotificationJSON;
     } else {
         throw ErrorResponse(404, "application", "invalid-value", "Invalid stream");
@@ -631,7 +851,65 @@ RestconfStreamRequest asRestconfStreamRequest(const std::string& httpMethod, con
 
     validateQueryParametersForStream(*queryParameters);
 
-    return {type, *queryParameters};
+    return {name, type, *queryParameters};
+}
+
+/** @brief Parses the query string of a telemetry request, which may only use the @p allowed parameters, each of them at most once */
+std::map<std::string, queryParams::QueryParamValue> asTelemetryQueryParams(const std::string& uriQueryString, const std::set<std::string>& allowed)
+{
+    auto queryParameters = impl::parseQueryParams(uriQueryString);
+    if (!queryParameters) {
+        throw ErrorResponse(400, "protocol", "invalid-value", "Query parameters syntax error");
+    }
+
+    std::map<std::string, queryParams::QueryParamValue> params;
+    for (const auto& [k, v] : *queryParameters) {
+        if (!allowed.contains(k)) {
+            throw ErrorResponse(400, "protocol", "invalid-value", "Unsupported query parameter \"" + k + "\"");
+        }
+        if (auto [it, inserted] = params.emplace(k, v); !inserted) {
+            throw ErrorResponse(400, "protocol", "invalid-value", "Query parameter '" + k + "' already specified");
+        }
+    }
+    return params;
+}
+
+/** @brief Translates the "fields" query parameter into an XPath selecting only the requested descendants of @p path
+ *
+ * The api-identifiers of the expression are the JSON-style qualified names, which is also what libyang expects in the XPath.
+ * When the @p path refers to the whole datastore, the expression selects the top-level nodes.
+ */
+std::string fieldsToXPath(const std::string& path, const queryParams::fields::Expr& expr)
+{
+    std::vector<std::string> paths;
+    fieldsToXPath(path == "/*" ? "" : path, expr, paths);
+
+    std::ostringstream oss;
+    std::copy(paths.begin(), paths.end(), std::experimental::make_ostream_joiner(oss, " | "));
+    return oss.str();
+}
+
+/** @brief Translates the "sort-by" query parameter into a path relative to a list entry, or "." for a leaf-list entry itself
+ *
+ * @return An empty string for "sort-by=none"
+ */
+std::string sortByToPath(const queryParams::QueryParamValue& sortBy)
+{
+    if (std::holds_alternative<queryParams::sortBy::Self>(sortBy)) {
+        return ".";
+    }
+    if (isSortByNone(sortBy)) {
+        return "";
+    }
+
+    std::vector<std::string> path;
+    for (const auto& apiIdent : std::get<queryParams::sortBy::Path>(sortBy)) {
+        path.emplace_back(apiIdentName(apiIdent));
+    }
+
+    std::ostringstream oss;
+    std::copy(path.begin(), path.end(), std::experimental::make_ostream_joiner(oss, "/"));
+    return oss.str();
 }
 
 /** @brief Returns a set of allowed HTTP methods for given URI. Usable for the 'allow' header */
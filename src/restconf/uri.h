@@ -15,6 +15,7 @@
 #include <string>
 #include <sysrepo-cpp/Enum.hpp>
 #include <variant>
+#include <vector>
 
 namespace libyang {
 class Context;
@@ -100,6 +101,47 @@ struct After {
 using PointParsed = std::vector<PathSegment>;
 }
 
+namespace fields {
+/** @brief One item of the RFC 8040 "fields" expression, i.e., a path which is optionally followed by a nested expression in parentheses */
+struct Field {
+    std::vector<ApiIdentifier> path;
+    std::vector<Field> children;
+
+    bool operator==(const Field&) const = default;
+};
+
+using Expr = std::vector<Field>;
+}
+
+namespace limit {
+struct Unbounded {
+    bool operator==(const Unbounded&) const = default;
+};
+}
+
+namespace direction {
+struct Forwards {
+    bool operator==(const Forwards&) const = default;
+};
+struct Backwards {
+    bool operator==(const Backwards&) const = default;
+};
+}
+
+namespace sortBy {
+/** @brief The value of a leaf-list entry itself, i.e., "sort-by=." */
+struct Self {
+    bool operator==(const Self&) const = default;
+};
+/** @brief A descendant of the list entry, relative to the entry */
+using Path = std::vector<ApiIdentifier>;
+}
+
+namespace modules {
+/** @brief A comma-separated list of module names, e.g., "modules=a,b" */
+using Names = std::vector<std::string>;
+}
+
 using QueryParamValue = std::variant<
     UnboundedDepth,
     unsigned int,
@@ -115,7 +157,14 @@ using QueryParamValue = std::variant<
     insert::Last,
     insert::Before,
     insert::After,
-    insert::PointParsed>;
+    insert::PointParsed,
+    fields::Expr,
+    limit::Unbounded,
+    direction::Forwards,
+    direction::Backwards,
+    sortBy::Self,
+    sortBy::Path,
+    modules::Names>;
 using QueryParams = std::multimap<std::string, QueryParamValue>;
 }
 
@@ -143,6 +192,8 @@ struct RestconfRequest {
 };
 
 struct RestconfStreamRequest {
+    /** @short Name of the stream, which is not validated yet */
+    std::string name;
     enum class Type {
         NetconfNotificationJSON,
         NetconfNotificationXML,
@@ -157,5 +208,8 @@ std::pair<std::string, PathSegment> asLibyangPathSplit(const libyang::Context& c
 std::vector<PathSegment> asPathSegments(const std::string& uriPath);
 std::optional<std::variant<libyang::Module, libyang::SubmoduleParsed>> asYangModule(const libyang::Context& ctx, const std::string& uriPath);
 RestconfStreamRequest asRestconfStreamRequest(const std::string& httpMethod, const std::string& uriPath, const std::string& uriQueryString);
+std::map<std::string, queryParams::QueryParamValue> asTelemetryQueryParams(const std::string& uriQueryString, const std::set<std::string>& allowed);
 std::set<std::string> allowedHttpMethodsForUri(const libyang::Context& ctx, const std::string& uriPath);
+std::string fieldsToXPath(const std::string& path, const queryParams::fields::Expr& expr);
+std::string sortByToPath(const queryParams::QueryParamValue& sortBy);
 }
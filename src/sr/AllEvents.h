@@ -5,10 +5,10 @@
  *
 */
 
-#include <boost/signals2.hpp>
 #include <memory>
 #include <optional>
 #include <sysrepo-cpp/Connection.hpp>
+#include "http/Broadcast.h"
 
 /** @short Communication with sysrepo */
 namespace rousette::sr {
@@ -22,7 +22,7 @@ public:
         RemoveEmptyOperationAndOrigin, ///< Remove sysrepo:operation=none and ietf-origin:unknown
         None, ///< Remove all attributes
     };
-    using Signal = boost::signals2::signal<void(const std::string& module, const std::string& json)>;
+    using Signal = http::Broadcast<std::string, std::string>;
     AllEvents(sysrepo::Session session, const WithAttributes attrBehavior);
 
     Signal change;
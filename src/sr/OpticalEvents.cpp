@@ -5,6 +5,7 @@
  *
 */
 
+#include <cctype>
 #include <memory>
 #include <set>
 #include <spdlog/spdlog.h>
@@ -17,55 +18,463 @@ std::string dumpDataFrom(sysrepo::Session session, const std::string& module)
 {
     return *session.getData('/' + module + ":*")->printStr(libyang::DataFormat::JSON, libyang::PrintFlags::WithSiblings);
 }
+
+std::string percentEncode(const std::string& str)
+{
+    static const auto hex = "0123456789ABCDEF";
+    std::string res;
+    for (unsigned char c : str) {
+        if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+            res += c;
+        } else {
+            res += '%';
+            res += hex[c >> 4];
+            res += hex[c & 0x0f];
+        }
+    }
+    return res;
+}
+
+void appendEdit(std::string& edits, unsigned& editId, const char* operation, const std::string& target, const std::optional<libyang::DataNode>& value)
+{
+    edits += editId ? "," : "";
+    edits += R"({"edit-id":")" + std::to_string(++editId) + R"(","operation":")" + operation + R"(","target":")" + target + '"';
+    if (value) {
+        // a copy without the parents (so that the value is just the target node) and without sysrepo's diff metadata
+        edits += R"(,"value":)" + *value->duplicate(libyang::DuplicationOptions::Recursive | libyang::DuplicationOptions::NoMeta).printStr(libyang::DataFormat::JSON, libyang::PrintFlags::Shrink);
+    }
+    edits += '}';
+}
+
+std::string yangPatch(const std::string& patchId, const std::string& edits)
+{
+    return R"({"patch-id":")" + patchId + R"(","edit":[)" + edits + "]}";
+}
+
+/** @short Is there an ancestor of the node (identified by its XPath) among the keys of @p nodes? */
+bool hasAncestorIn(const std::string& path, const std::map<std::string, std::string>& nodes)
+{
+    // a slash within a list key value might yield a bogus prefix as well, but that one is never found
+    for (auto pos = path.rfind('/'); pos != std::string::npos && pos > 0; pos = path.rfind('/', pos - 1)) {
+        if (nodes.contains(path.substr(0, pos))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @short Is the node within one of the subtrees (identified by their paths)? */
+bool isWithin(const libyang::DataNode& node, const std::set<std::string>& subtrees)
+{
+    for (auto parent = node.parent(); parent; parent = parent->parent()) {
+        if (subtrees.contains(parent->path())) {
+            return true;
+        }
+    }
+    return false;
+}
 }
 
 namespace rousette::sr {
 
-OpticalEvents::OpticalEvents(sysrepo::Session session)
-    : sub(std::nullopt)
+/** @short RESTCONF data resource identifier (RFC 8040, section 3.5.3) of a data node */
+std::string asResourceIdentifier(const libyang::DataNode& node)
+{
+    std::vector<libyang::DataNode> nodes;
+    for (std::optional<libyang::DataNode> n = node; n; n = n->parent()) {
+        nodes.emplace_back(*n);
+    }
+
+    std::string res;
+    std::string parentModule;
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+        auto schema = it->schema();
+        std::string module{schema.module().name()};
+
+        res += '/';
+        if (module != parentModule) {
+            res += module + ':';
+        }
+        res += schema.name();
+        parentModule = module;
+
+        if (schema.nodeType() == libyang::NodeType::List) {
+            std::string keys;
+            for (const auto& key : schema.asList().keys()) {
+                keys += (keys.empty() ? "=" : ",") + percentEncode(std::string{it->findPath(key.name())->asTerm().valueStr()});
+            }
+            res += keys;
+        } else if (schema.nodeType() == libyang::NodeType::Leaflist) {
+            res += '=' + percentEncode(std::string{it->asTerm().valueStr()});
+        }
+    }
+    return res;
+}
+
+/** @short Serializes the changes as the JSON content of a YANG Patch (RFC 8072)
+ *
+ * sysrepo reports each descendant of a created or deleted node as a separate change. These are folded into the edit of
+ * the topmost node. Moves within user-ordered lists are sent as a replace of the moved node.
+ */
+std::string asYangPatch(const std::string& patchId, const std::vector<DataChange>& changes)
+{
+    std::set<std::string> createdOrDeleted;
+    std::string edits;
+    unsigned editId = 0;
+
+    for (const auto& [operation, node] : changes) {
+        if (isWithin(node, createdOrDeleted)) {
+            continue;
+        }
+
+        const char* editOperation;
+        switch (operation) {
+        case sysrepo::ChangeOperation::Created:
+            editOperation = "create";
+            createdOrDeleted.emplace(node.path());
+            break;
+        case sysrepo::ChangeOperation::Deleted:
+            editOperation = "delete";
+            createdOrDeleted.emplace(node.path());
+            break;
+        case sysrepo::ChangeOperation::Modified:
+        case sysrepo::ChangeOperation::Moved:
+            editOperation = "replace";
+            break;
+        default:
+            __builtin_unreachable();
+        }
+
+        appendEdit(edits, editId, editOperation, asResourceIdentifier(node), operation == sysrepo::ChangeOperation::Deleted ? std::nullopt : std::optional{node});
+    }
+
+    return yangPatch(patchId, edits);
+}
+
+/** @short YANG Patch which brings a client up to date with @p data, given the nodes which have changed since its last update
+ *
+ * This is for changes which were coalesced over some time. Nodes which exist now are replaced with their current value,
+ * the rest is removed. Nodes whose ancestor has changed as well are covered by the edit of that ancestor.
+ *
+ * @param changedNodes XPath of each changed node -> its RESTCONF resource identifier
+ */
+std::string asYangPatch(const std::string& patchId, const std::optional<libyang::DataNode>& data, const std::map<std::string, std::string>& changedNodes)
 {
-    session.switchDatastore(sysrepo::Datastore::Operational);
+    std::string edits;
+    unsigned editId = 0;
+
+    for (const auto& [path, target] : changedNodes) {
+        if (hasAncestorIn(path, changedNodes)) {
+            continue;
+        }
+
+        if (auto node = data ? data->findPath(path) : std::nullopt) {
+            appendEdit(edits, editId, "replace", target, node);
+        } else {
+            appendEdit(edits, editId, "remove", target, std::nullopt);
+        }
+    }
+
+    return yangPatch(patchId, edits);
+}
 
-    // Because it's "tricky" to request data from several top-level modules via sysrepo (and nothing else),
-    // just pick a first module to listen for.
+OpticalEvents::OpticalEvents(sysrepo::Session session, const std::chrono::seconds snapshotInterval, const std::chrono::milliseconds dampeningPeriod, const std::chrono::seconds gracePeriod)
+    : dataSession(session)
+    , snapshotInterval(snapshotInterval)
+    , dampeningPeriod(dampeningPeriod)
+    , gracePeriod(gracePeriod)
+{
+    dataSession.switchDatastore(sysrepo::Datastore::Operational);
+
+    // A device might implement several of these, and each of them is dumped and reported on its own
     for (const auto& mod : {"czechlight-roadm-device", "czechlight-coherent-add-drop", "czechlight-inline-amp", "czechlight-bidi-amp"}) {
-        try {
-            sysrepo::ModuleChangeCb cb = [this](const auto sess, auto, auto name, auto, auto, auto) {
-                return onChange(sess, std::string{name});
-            };
-            sub = session.onModuleChange(mod, cb, std::nullopt, 0, sysrepo::SubscribeOptions::DoneOnly | sysrepo::SubscribeOptions::Passive);
-            spdlog::debug("Listening for module {}", mod);
-            std::unique_lock lock{mtx};
-            lastData = dumpDataFrom(session, mod);
+        if (dataSession.getContext().getModuleImplemented(mod)) {
+            watchedModules.emplace(mod);
+            state[mod].lastSnapshot = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (watchedModules.empty()) {
+        spdlog::warn("Telemetry disabled. No CzechLight YANG modules found.");
+        return;
+    }
+    workerThread = std::jthread{[this](std::stop_token stop) { worker(stop); }};
+}
+
+OpticalEvents::~OpticalEvents()
+{
+    workerThread = {};
+    std::unique_lock lock{subMtx};
+    sub.reset();
+}
+
+/** @short Start watching sysrepo if nobody has done that yet; the updates are sent until the returned handle goes away
+ *
+ * The first subscription starts with a Snapshot update of each module, because whatever happened while nobody was
+ * watching is lost.
+ *
+ * This blocks while sysrepo sets up the subscriptions and while the data are being dumped, which only happens for the
+ * first client after an idle grace period. Do not call this from a thread which serves other clients meanwhile.
+ */
+std::shared_ptr<void> OpticalEvents::subscribe()
+{
+    auto handle = std::shared_ptr<void>{nullptr, [weak = weak_from_this()](void*) {
+        if (auto self = weak.lock()) {
+            self->unsubscribe();
+        }
+    }};
+    if (watchedModules.empty()) {
+        return handle;
+    }
+
+    std::unique_lock subLock{subMtx};
+    {
+        std::unique_lock lock{mtx};
+        ++subscribers;
+        stopAt.reset();
+        if (sub) {
+            return handle;
+        }
+    }
+
+    // not under `mtx`, the callback might be already running
+    sysrepo::ModuleChangeCb cb = [this](const auto sess, auto, auto name, auto, auto, auto) {
+        return onChange(sess, std::string{name});
+    };
+    for (const auto& module : watchedModules) {
+        if (!sub) {
+            sub = dataSession.onModuleChange(module, cb, std::nullopt, 0, sysrepo::SubscribeOptions::DoneOnly | sysrepo::SubscribeOptions::Passive);
+        } else {
+            sub->onModuleChange(module, cb, std::nullopt, 0, sysrepo::SubscribeOptions::DoneOnly | sysrepo::SubscribeOptions::Passive);
+        }
+        spdlog::debug("Listening for module {}", module);
+    }
+
+    std::unique_lock lock{mtx};
+    watching = true;
+    std::vector<Update> updates;
+    for (auto& [module, moduleState] : state) {
+        moduleState.pendingChanges.clear();
+        moduleState.flushAt.reset();
+        updates.emplace_back(snapshotLocked(module, moduleState, dumpDataFrom(dataSession, module)));
+    }
+    // the periodic snapshots are due from now on
+    wakeup.notify_one();
+    emit(lock, updates);
+    return handle;
+}
+
+void OpticalEvents::unsubscribe()
+{
+    std::unique_lock lock{mtx};
+    if (watchedModules.empty() || --subscribers) {
+        return;
+    }
+    stopAt = std::chrono::steady_clock::now() + gracePeriod;
+    wakeup.notify_one();
+}
+
+/** @short Stop watching sysrepo once the grace period is over and nobody has subscribed meanwhile */
+void OpticalEvents::stopIfUnused()
+{
+    std::optional<sysrepo::Subscription> unused;
+    {
+        std::unique_lock subLock{subMtx};
+        std::unique_lock lock{mtx};
+        if (subscribers || !stopAt || std::chrono::steady_clock::now() < *stopAt) {
             return;
-        } catch (sysrepo::ErrorWithCode& e) {
-            if (e.code() == sysrepo::ErrorCode::NotFound) {
-                // nothing to listen for, just ignore this
-                continue;
-            }
-            throw;
+        }
+        stopAt.reset();
+        unused = std::move(sub);
+        sub.reset();
+        watching = false;
+        for (auto& [module, moduleState] : state) {
+            moduleState.pendingChanges.clear();
+            moduleState.flushAt.reset();
         }
     }
+    // not under `mtx`, sysrepo waits for the callbacks to finish
+    unused.reset();
+    spdlog::debug("No optics telemetry clients, stopped listening for {} modules", watchedModules.size());
+}
 
-    spdlog::warn("Telemetry disabled. No CzechLight YANG modules found.");
+/** @short Remember the complete data of a module, and prepare them for everybody. Expects the mutex to be held. */
+OpticalEvents::Update OpticalEvents::snapshotLocked(const std::string& module, Module& moduleState, std::string json)
+{
+    moduleState.lastSnapshot = std::chrono::steady_clock::now();
+    moduleState.lastData = std::make_shared<const std::string>(std::move(json));
+    moduleState.dirty = false;
+    spdlog::debug("change: snapshot of {}, {} bytes", module, moduleState.lastData->size());
+    return Update{Update::Type::Snapshot, module, *moduleState.lastData};
+}
+
+/** @short Send the updates once `lock` of the mutex is released, but before anybody can see data which are newer
+ *
+ * The slots are not invoked with the mutex held, so that they can take their own locks. The updates still go out in
+ * the order in which they were prepared, and withCurrentData() waits for them, so that no patch slips in between.
+ */
+void OpticalEvents::emit(std::unique_lock<std::mutex>& lock, const std::vector<Update>& updates)
+{
+    std::unique_lock emitLock{emitMtx};
+    lock.unlock();
+    for (const auto& update : updates) {
+        change(update);
+    }
 }
 
 sysrepo::ErrorCode OpticalEvents::onChange(sysrepo::Session session, const std::string& module)
 {
     std::unique_lock lock{mtx};
     assert(session.activeDatastore() == sysrepo::Datastore::Operational);
-    lastData = dumpDataFrom(session, module);
-    spdlog::debug("change: {} bytes", lastData.size());
+    auto& moduleState = state.at(module);
 
-    // I wanted this to be a bit smarter, with a subtree filter to remove "unwated changes" and what not.
-    // Given that we do not have a full-blown subtree filtering (yet), let's just return the data upon any change.
-    change(lastData);
+    if (dampeningPeriod.count()) {
+        // Just remember what has changed. Changes are coalesced and sent at most once per dampening period, see worker().
+        for (const auto& ch : session.getChanges()) {
+            moduleState.pendingChanges.try_emplace(ch.node.path(), asResourceIdentifier(ch.node));
+        }
+        moduleState.dirty = true;
+        if (!moduleState.pendingChanges.empty() && !moduleState.flushAt) {
+            // right away if nothing was sent within the last period
+            moduleState.flushAt = std::max(std::chrono::steady_clock::now(), moduleState.lastEmission + dampeningPeriod);
+            wakeup.notify_one();
+        }
+        return sysrepo::ErrorCode::Ok;
+    }
+
+    std::vector<DataChange> changes;
+    for (const auto& ch : session.getChanges()) {
+        changes.push_back({ch.operation, ch.node});
+    }
+    // the complete data are only needed when a new client connects
+    moduleState.dirty = true;
+    if (changes.empty()) {
+        return sysrepo::ErrorCode::Ok;
+    }
+
+    auto patch = asYangPatch(std::to_string(++moduleState.lastPatchId), changes);
+    spdlog::debug("change: patch of {}, {} bytes", module, patch.size());
+    emit(lock, {Update{Update::Type::Patch, module, patch}});
     return sysrepo::ErrorCode::Ok;
 }
 
-std::string OpticalEvents::currentData() const
+/** @short When the next periodic snapshot of a module is due, if any. Expects the mutex to be held. */
+std::optional<std::chrono::steady_clock::time_point> OpticalEvents::nextSnapshotLocked(const Module& moduleState) const
+{
+    if (!watching || !snapshotInterval.count()) {
+        return std::nullopt;
+    }
+    return moduleState.lastSnapshot + snapshotInterval;
+}
+
+/** @short Send the periodic snapshots and the dampened changes, and stop watching sysrepo when there are no subscribers
+ *
+ * Clients which missed something (or which apply patches incorrectly) resynchronize on the periodic snapshots, which
+ * is why these are sent even when nothing changes.
+ */
+void OpticalEvents::worker(std::stop_token stop)
+{
+    auto nextDeadline = [this]() {
+        auto res = stopAt;
+        for (const auto& [module, moduleState] : state) {
+            for (const auto& deadline : {moduleState.flushAt, nextSnapshotLocked(moduleState)}) {
+                if (deadline && (!res || *deadline < *res)) {
+                    res = deadline;
+                }
+            }
+        }
+        return res;
+    };
+
+    std::unique_lock lock{mtx};
+    while (!stop.stop_requested()) {
+        auto deadline = nextDeadline();
+        if (!deadline) {
+            wakeup.wait(lock, stop, [&] { return nextDeadline().has_value(); });
+            continue;
+        }
+        // a new deadline might be sooner than this one
+        wakeup.wait_until(lock, stop, *deadline, [&] { return nextDeadline() != deadline; });
+        if (stop.stop_requested()) {
+            break;
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::vector<Update> updates;
+        for (auto& [module, moduleState] : state) {
+            if (auto snapshotAt = nextSnapshotLocked(moduleState); snapshotAt && *snapshotAt <= now) {
+                // whatever is pending is covered by the snapshot
+                moduleState.pendingChanges.clear();
+                moduleState.flushAt.reset();
+                updates.emplace_back(snapshotLocked(module, moduleState, dumpDataFrom(dataSession, module)));
+            } else if (moduleState.flushAt && *moduleState.flushAt <= now) {
+                updates.emplace_back(flushLocked(module, moduleState));
+            }
+        }
+        if (!updates.empty()) {
+            emit(lock, updates);
+            lock.lock();
+        }
+        if (stopAt && *stopAt <= now) {
+            lock.unlock();
+            stopIfUnused();
+            lock.lock();
+        }
+    }
+}
+
+/** @short Prepare everything which has changed in a module during the dampening period. Expects the mutex to be held. */
+OpticalEvents::Update OpticalEvents::flushLocked(const std::string& module, Module& moduleState)
+{
+    moduleState.flushAt.reset();
+    moduleState.lastEmission = std::chrono::steady_clock::now();
+
+    auto patch = asYangPatch(std::to_string(++moduleState.lastPatchId), dataSession.getData('/' + module + ":*"), moduleState.pendingChanges);
+    spdlog::debug("change: patch of {}, {} bytes, {} nodes coalesced", module, patch.size(), moduleState.pendingChanges.size());
+    moduleState.pendingChanges.clear();
+    return Update{Update::Type::Patch, module, patch};
+}
+
+/** @short Current data of a module, serialized only when they changed since the last time. Expects the mutex to be held.
+ *
+ * Without a sysrepo subscription, nothing is known about the changes, so the data are always read again. Whoever holds
+ * the previous data keeps them, they are never modified.
+ */
+const OpticalEvents::Data& OpticalEvents::currentDataLocked(const std::string& module) const
+{
+    auto& moduleState = state.at(module);
+    if (moduleState.dirty || !watching || !moduleState.lastData) {
+        moduleState.lastData = std::make_shared<const std::string>(dumpDataFrom(dataSession, module));
+        moduleState.dirty = false;
+    }
+    return moduleState.lastData;
+}
+
+/** @short Modules which are watched; these do not change during the lifetime of this object */
+const std::set<std::string>& OpticalEvents::modules() const
+{
+    return watchedModules;
+}
+
+OpticalEvents::Data OpticalEvents::currentData(const std::string& module) const
+{
+    std::unique_lock lock{mtx};
+    return currentDataLocked(module);
+}
+
+/** @short Invoke the callback with current data of the modules while no change can be emitted, so that no patch slips in between
+ *
+ * Changes which are older than the data have been emitted before the callback is invoked, and the newer ones wait
+ * until it returns. The callback may take the locks which the slots of `change` take.
+ */
+void OpticalEvents::withCurrentData(const std::set<std::string>& modules, const std::function<void(const std::map<std::string, Data>& data)>& cb) const
 {
     std::unique_lock lock{mtx};
-    return lastData;
+    std::map<std::string, Data> data;
+    for (const auto& module : modules) {
+        data.emplace(module, currentDataLocked(module));
+    }
+    std::unique_lock emitLock{emitMtx};
+    lock.unlock();
+    cb(data);
 }
 }
@@ -5,29 +5,105 @@
  *
 */
 
-#include <boost/signals2.hpp>
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <thread>
 #include <sysrepo-cpp/Connection.hpp>
+#include "http/Broadcast.h"
 
 /** @short Communication with sysrepo */
 namespace rousette::sr {
 
-/** @short Listen for ops updates of DWDM-related parameters */
-class OpticalEvents {
+/** @short One change of a data node, as reported by sysrepo */
+struct DataChange {
+    sysrepo::ChangeOperation operation;
+    libyang::DataNode node;
+};
+
+std::string asYangPatch(const std::string& patchId, const std::vector<DataChange>& changes);
+std::string asYangPatch(const std::string& patchId, const std::optional<libyang::DataNode>& data, const std::map<std::string, std::string>& changedNodes);
+std::string asResourceIdentifier(const libyang::DataNode& node);
+
+/** @short Listen for ops updates of DWDM-related parameters
+
+All of the CzechLight modules which are implemented are watched, and each of them is reported separately, with its own
+snapshots and patches.
+
+Nothing is watched until somebody needs the updates, see subscribe(). Once the last subscriber is gone, sysrepo is
+still watched for a grace period, so that a client which reconnects right away does not have to wait for a new dump.
+
+The subscription handles might outlive their creator, so this has to be owned by a shared_ptr.
+*/
+class OpticalEvents : public std::enable_shared_from_this<OpticalEvents> {
 public:
-    using Signal = boost::signals2::signal<void(const std::string& json)>;
-    OpticalEvents(sysrepo::Session session);
+    /** @short What has changed */
+    struct Update {
+        enum class Type {
+            Snapshot, ///< Complete data of the module
+            Patch, ///< A YANG Patch with changes since the previous update of the module
+        };
+        Type type;
+        std::string module;
+        std::string json;
+    };
+    using Signal = http::Broadcast<Update>;
+    /** @short Serialized data of a module; these are never modified, so they can be shared without copying */
+    using Data = std::shared_ptr<const std::string>;
+    OpticalEvents(sysrepo::Session session, const std::chrono::seconds snapshotInterval = std::chrono::seconds{60}, const std::chrono::milliseconds dampeningPeriod = std::chrono::milliseconds{0}, const std::chrono::seconds gracePeriod = std::chrono::seconds{30});
+    ~OpticalEvents();
 
     Signal change;
 
-    std::string currentData() const;
+    std::shared_ptr<void> subscribe();
+    const std::set<std::string>& modules() const;
+    Data currentData(const std::string& module) const;
+    void withCurrentData(const std::set<std::string>& modules, const std::function<void(const std::map<std::string, Data>& data)>& cb) const;
 
 private:
+    /** @short State of a single watched module */
+    struct Module {
+        std::chrono::steady_clock::time_point lastSnapshot;
+        uint64_t lastPatchId = 0;
+        Data lastData;
+        bool dirty = false;
+        std::chrono::steady_clock::time_point lastEmission;
+        /** @short Nodes which changed during the current dampening period, XPath -> RESTCONF resource identifier */
+        std::map<std::string, std::string> pendingChanges;
+        std::optional<std::chrono::steady_clock::time_point> flushAt;
+    };
+
     sysrepo::ErrorCode onChange(sysrepo::Session session, const std::string& module);
+    const Data& currentDataLocked(const std::string& module) const;
+    Update snapshotLocked(const std::string& module, Module& state, std::string json);
+    void emit(std::unique_lock<std::mutex>& lock, const std::vector<Update>& updates);
+    void unsubscribe();
+    void worker(std::stop_token stop);
+    std::optional<std::chrono::steady_clock::time_point> nextSnapshotLocked(const Module& state) const;
+    Update flushLocked(const std::string& module, Module& state);
+    void stopIfUnused();
 
     mutable std::mutex mtx;
+    mutable std::mutex emitMtx; // serializes the emission of `change`, taken with `mtx` held and then kept without it
+    mutable sysrepo::Session dataSession;
+    std::set<std::string> watchedModules;
+    std::chrono::seconds snapshotInterval;
+    mutable std::map<std::string, Module> state;
+    std::chrono::milliseconds dampeningPeriod;
+    std::chrono::seconds gracePeriod;
+    std::size_t subscribers = 0;
+    /** @short Whether the changes are being tracked via `sub` */
+    bool watching = false;
+    /** @short When to stop watching sysrepo, unless somebody subscribes again */
+    std::optional<std::chrono::steady_clock::time_point> stopAt;
+    std::condition_variable_any wakeup;
+    std::mutex subMtx; // for `sub`; never taken from the sysrepo callbacks, unlike `mtx`
     std::optional<sysrepo::Subscription> sub;
-    std::string lastData;
+    std::jthread workerThread;
 };
 }
@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+/* Benchmarks, not tests. They are built together with the tests, but they are not registered with CTest.
+ * Run them via the `benchmark` build target. */
+
+static const auto SERVER_PORT = "10092";
+#include "trompeloeil_doctest.h"
+#include <atomic>
+#include <boost/signals2.hpp>
+#include <chrono>
+#include <ctime>
+#include <libyang-cpp/Context.hpp>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <sysrepo-cpp/Connection.hpp>
+#include <sysrepo-cpp/utils/exception.hpp>
+#include <thread>
+#include <vector>
+#include "http/Broadcast.h"
+#include "http/EventStream.h"
+#include "restconf/NotificationStream.h"
+#include "restconf/Server.h"
+#include "sr/OpticalEvents.h"
+#include "tests/aux-utils.h"
+#include "tests/configure.cmake.h"
+
+using namespace std::string_literals;
+
+namespace {
+const auto benchmarkMessage = R"({
+  "ietf-restconf:notification": {
+    "eventTime": "2024-01-01T00:00:00Z",
+    "example:eventA": {
+      "message": "something happened",
+      "progress": 42
+    }
+  }
+}
+)"s;
+
+template <typename Duration>
+double perSecond(const std::size_t count, const Duration duration)
+{
+    return count / std::chrono::duration<double>(duration).count();
+}
+
+/** @short Stores a list with entries which are much larger than their keys */
+void populateLargeList(sysrepo::Session session, const int numEntries)
+{
+    for (int i = 0; i < numEntries; ++i) {
+        auto entry = "/example:tlc/list[name='entry-" + std::to_string(i) + "']";
+        session.setItem(entry + "/choice1", "something rather long which the client does not need");
+        for (int j = 0; j < 5; ++j) {
+            session.setItem(entry + "/collection", std::to_string(j));
+            session.setItem(entry + "/nested[first='a'][second='" + std::to_string(j) + "'][third='b']", std::nullopt);
+        }
+    }
+    session.applyChanges();
+}
+
+libyang::Context exampleContext()
+{
+    auto ctx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+    ctx.loadModule("example", std::nullopt, {"f1"});
+    return ctx;
+}
+}
+
+TEST_CASE("event stream enqueue and drain throughput")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numEvents = 200'000;
+
+    rousette::http::EventQueue queue;
+    std::vector<uint8_t> buf(16384); // the usual size of nghttp2's DATA chunk
+
+    auto start = Clock::now();
+    for (int i = 0; i < numEvents; ++i) {
+        queue.push(rousette::http::makeEvent(benchmarkMessage));
+    }
+    auto enqueued = Clock::now();
+    auto totalBytes = queue.bytes();
+    while (!queue.empty()) {
+        queue.drain(buf.data(), buf.size());
+    }
+    auto drained = Clock::now();
+
+    spdlog::info("{} events, {} bytes: framed and enqueued {:.0f} events/s, drained {:.0f} events/s",
+                 numEvents, totalBytes, perSecond(numEvents, enqueued - start), perSecond(numEvents, drained - enqueued));
+}
+
+TEST_CASE("event stream fan-out")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numSubscribers = 1'000;
+    constexpr auto numEvents = 1'000;
+
+    std::vector<rousette::http::EventQueue> queues(numSubscribers);
+    std::vector<uint8_t> buf(16384);
+    auto drainEverything = [&]() {
+        for (auto& queue : queues) {
+            while (!queue.empty()) {
+                queue.drain(buf.data(), buf.size());
+            }
+        }
+    };
+
+    // what used to happen: each subscriber frames its own copy of the event
+    auto start = Clock::now();
+    for (int i = 0; i < numEvents; ++i) {
+        for (auto& queue : queues) {
+            queue.push(rousette::http::makeEvent(benchmarkMessage));
+        }
+    }
+    auto perSubscriber = Clock::now() - start;
+    drainEverything();
+
+    start = Clock::now();
+    for (int i = 0; i < numEvents; ++i) {
+        auto event = rousette::http::makeEvent(benchmarkMessage);
+        for (auto& queue : queues) {
+            queue.push(event);
+        }
+    }
+    auto shared = Clock::now() - start;
+    drainEverything();
+
+    spdlog::info("{} events to {} subscribers: framed per subscriber {:.0f} events/s, framed once and shared {:.0f} events/s",
+                 numEvents, numSubscribers, perSecond(numEvents, perSubscriber), perSecond(numEvents, shared));
+}
+
+TEST_CASE("notification subscription setup latency")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto rounds = 20;
+
+    auto srConn = sysrepo::Connection{};
+    auto sess = srConn.sessionStart();
+    auto ctx = sess.getContext();
+    auto cb = [](auto, auto, auto, auto, auto) {};
+
+    // subscribing to everything, and letting sysrepo tell which modules have no notifications
+    auto start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        std::optional<sysrepo::Subscription> sub;
+        for (const auto& mod : ctx.modules()) {
+            if (!mod.implemented() || mod.name() == "sysrepo") {
+                continue;
+            }
+            try {
+                if (!sub) {
+                    sub = sess.onNotification(mod.name(), cb);
+                } else {
+                    sub->onNotification(mod.name(), cb);
+                }
+            } catch (const sysrepo::ErrorWithCode& e) {
+                if (e.code() != sysrepo::ErrorCode::NotFound) {
+                    throw;
+                }
+            }
+        }
+    }
+    auto trial = Clock::now() - start;
+
+    start = Clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        std::optional<sysrepo::Subscription> sub;
+        for (const auto& mod : rousette::restconf::notificationModules(ctx)) {
+            if (!sub) {
+                sub = sess.onNotification(mod, cb);
+            } else {
+                sub->onNotification(mod, cb);
+            }
+        }
+    }
+    auto indexed = Clock::now() - start;
+
+    spdlog::info("subscribing to all notifications: {} ms by trial and error, {} ms with the schema index",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(trial / rounds).count(),
+                 std::chrono::duration_cast<std::chrono::milliseconds>(indexed / rounds).count());
+}
+
+TEST_CASE("optics telemetry bandwidth on a change trace")
+{
+    constexpr auto numEntries = 256;
+    constexpr auto numChanges = 10'000;
+
+    auto ctx = exampleContext();
+    auto tree = *ctx.newPath("/example:tlc");
+    for (int i = 0; i < numEntries; ++i) {
+        tree.newPath("/example:tlc/list[name='channel-" + std::to_string(i) + "']/choice1", "-10.0");
+    }
+
+    // the trace: each change updates a single reading, which is what the amplifiers do most of the time
+    std::size_t snapshotBytes = 0;
+    std::size_t patchBytes = 0;
+    for (int i = 0; i < numChanges; ++i) {
+        auto path = "/example:tlc/list[name='channel-" + std::to_string((i * 7) % numEntries) + "']/choice1";
+        tree.newPath(path, "-" + std::to_string(i % 20) + ".5", libyang::CreationOptions::Update);
+        auto node = *tree.findPath(path);
+        snapshotBytes += tree.printStr(libyang::DataFormat::JSON, libyang::PrintFlags::WithSiblings)->size();
+        patchBytes += rousette::sr::asYangPatch(std::to_string(i), {{sysrepo::ChangeOperation::Modified, node}}).size();
+    }
+
+    spdlog::info("{} changes: {} bytes as full snapshots, {} bytes as patches, {:.1f}% saved",
+                 numChanges, snapshotBytes, patchBytes, 100.0 * (snapshotBytes - patchBytes) / snapshotBytes);
+}
+
+TEST_CASE("batched delivery at 10k events/s")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto rate = 10'000;
+    constexpr auto numEvents = 20'000;
+    const rousette::http::Batching batching{.maxEvents = 100, .window = std::chrono::milliseconds{10}, .prefix = "[", .separator = ",", .suffix = "]"};
+
+    // each delivery to the client means a wakeup of the I/O thread and a DATA frame, so a batch is drained at once
+    auto run = [&](bool batched) {
+        rousette::http::EventQueue queue;
+        std::vector<uint8_t> buf(16384);
+        std::vector<rousette::http::EventPtr> batch;
+        std::size_t wakeups = 0;
+        auto deliver = [&](const rousette::http::EventPtr& event) {
+            queue.push(event);
+            ++wakeups;
+            while (!queue.empty()) {
+                queue.drain(buf.data(), buf.size());
+            }
+        };
+
+        auto cpuStart = std::clock();
+        auto start = Clock::now();
+        auto batchStart = start;
+        for (int i = 0; i < numEvents; ++i) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds{1'000'000 / rate} * i);
+            auto event = rousette::http::makeEvent(benchmarkMessage, i);
+            if (!batched) {
+                deliver(event);
+                continue;
+            }
+            if (batch.empty()) {
+                batchStart = Clock::now();
+            }
+            batch.push_back(event);
+            if (batch.size() >= batching.maxEvents || Clock::now() - batchStart >= batching.window) {
+                deliver(rousette::http::Event::batch(batch, batching));
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            deliver(rousette::http::Event::batch(batch, batching));
+        }
+        auto cpu = std::chrono::duration<double, std::micro>{1'000'000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC};
+        return std::pair{cpu.count() / numEvents, wakeups};
+    };
+
+    auto [single, singleWakeups] = run(false);
+    auto [batched, batchedWakeups] = run(true);
+    spdlog::info("{} events at {} events/s: one by one {:.2f} us CPU/event with {} wakeups, batched {:.2f} us CPU/event with {} wakeups",
+                 numEvents, rate, single, singleWakeups, batched, batchedWakeups);
+}
+
+TEST_CASE("subscriber registry: Broadcast vs. boost::signals2")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numSubscribers = 1'000;
+    constexpr auto numEvents = 1'000;
+    constexpr auto numPublishers = 4;
+    auto event = rousette::http::makeEvent(benchmarkMessage);
+
+    // each subscriber takes its own lock, just like EventStream::enqueue() does
+    struct Subscriber {
+        std::mutex mtx;
+        std::size_t received = 0;
+        void operator()(const rousette::http::EventPtr&)
+        {
+            std::lock_guard lock{mtx};
+            ++received;
+        }
+    };
+
+    auto run = [&](auto& signal, auto connect) {
+        std::vector<Subscriber> subscribers(numSubscribers);
+        std::vector<decltype(connect(signal, subscribers[0]))> connections;
+        for (auto& subscriber : subscribers) {
+            connections.emplace_back(connect(signal, subscriber));
+        }
+
+        // meanwhile, clients keep connecting and disconnecting
+        std::atomic<bool> done{false};
+        std::jthread churn{[&]() {
+            Subscriber subscriber;
+            while (!done) {
+                auto connection = connect(signal, subscriber);
+                connection.disconnect();
+            }
+        }};
+
+        auto start = Clock::now();
+        {
+            std::vector<std::jthread> publishers;
+            for (int i = 0; i < numPublishers; ++i) {
+                publishers.emplace_back([&]() {
+                    for (int j = 0; j < numEvents; ++j) {
+                        signal(event);
+                    }
+                });
+            }
+        }
+        auto duration = Clock::now() - start;
+        done = true;
+        return duration;
+    };
+
+    boost::signals2::signal<void(const rousette::http::EventPtr&)> signals2;
+    auto signals2Duration = run(signals2, [](auto& signal, Subscriber& subscriber) {
+        return signal.connect([&subscriber](const auto& event) { subscriber(event); });
+    });
+
+    rousette::http::Broadcast<rousette::http::EventPtr> broadcast;
+    auto broadcastDuration = run(broadcast, [](auto& signal, Subscriber& subscriber) {
+        return signal.connect([&subscriber](const auto& event) { subscriber(event); });
+    });
+
+    spdlog::info("{} publishers, {} events each, {} subscribers: boost::signals2 {:.0f} deliveries/s, Broadcast {:.0f} deliveries/s",
+                 numPublishers, numEvents, numSubscribers,
+                 perSecond(numPublishers * numEvents * numSubscribers, signals2Duration),
+                 perSecond(numPublishers * numEvents * numSubscribers, broadcastDuration));
+}
+
+TEST_CASE("length-prefixed frames vs. text/event-stream")
+{
+    using Clock = std::chrono::steady_clock;
+    using rousette::http::Framing;
+    constexpr auto numEvents = 200'000;
+
+    std::vector<rousette::http::EventPtr> events;
+    for (int i = 0; i < numEvents; ++i) {
+        events.push_back(rousette::http::makeEvent(benchmarkMessage, i));
+    }
+
+    auto drainEverything = [&](Framing framing) {
+        rousette::http::EventQueue queue{{}, framing};
+        std::vector<uint8_t> buf(16384);
+        std::string wire;
+        for (const auto& event : events) {
+            queue.push(event);
+        }
+        while (!queue.empty()) {
+            auto written = queue.drain(buf.data(), buf.size());
+            wire.append(reinterpret_cast<const char*>(buf.data()), written);
+        }
+        return wire;
+    };
+
+    // what a client has to do to get the messages back
+    auto parseSse = [](const std::string& wire) {
+        std::size_t count = 0;
+        std::string message;
+        for (std::size_t begin = 0; begin < wire.size();) {
+            auto end = wire.find('\n', begin);
+            std::string_view line{wire.data() + begin, end - begin};
+            if (line.empty()) {
+                ++count;
+                message.clear();
+            } else if (line.starts_with("data: ")) {
+                message.append(line.substr(6));
+                message += '\n';
+            }
+            begin = end + 1;
+        }
+        return count;
+    };
+    auto parseLengthPrefixed = [](const std::string& wire) {
+        std::size_t count = 0;
+        for (std::size_t begin = 0; begin < wire.size();) {
+            std::size_t length = 0;
+            for (int i = 0; i < 4; ++i) {
+                length = (length << 8) | static_cast<uint8_t>(wire[begin + i]);
+            }
+            std::string_view message{wire.data() + begin + rousette::http::Event::BinaryHeaderSize, length};
+            count += !message.empty();
+            begin += rousette::http::Event::BinaryHeaderSize + length;
+        }
+        return count;
+    };
+
+    auto start = Clock::now();
+    auto sse = drainEverything(Framing::Sse);
+    auto sseDrained = Clock::now();
+    REQUIRE(parseSse(sse) == numEvents);
+    auto sseParsed = Clock::now();
+
+    auto binary = drainEverything(Framing::LengthPrefixed);
+    auto binaryDrained = Clock::now();
+    REQUIRE(parseLengthPrefixed(binary) == numEvents);
+    auto binaryParsed = Clock::now();
+
+    spdlog::info("{} events: text/event-stream {} bytes, sent {:.0f} events/s, parsed {:.0f} events/s; "
+                 "length-prefixed {} bytes, sent {:.0f} events/s, parsed {:.0f} events/s",
+                 numEvents,
+                 sse.size(), perSecond(numEvents, sseDrained - start), perSecond(numEvents, sseParsed - sseDrained),
+                 binary.size(), perSecond(numEvents, binaryDrained - sseParsed), perSecond(numEvents, binaryParsed - binaryDrained));
+}
+
+TEST_CASE("YANG patch with 10k edits")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numEdits = 10'000;
+
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    auto nacmGuard = manageNacm(srSess);
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    setupRealNacm(srSess);
+
+    auto yangPatch = [](const std::string& patchId, auto&& editFor) {
+        std::string edits;
+        for (int i = 0; i < numEdits; ++i) {
+            edits += (i ? "," : "") + editFor(i);
+        }
+        return R"({"ietf-yang-patch:yang-patch": {"patch-id": ")" + patchId + R"(", "edit": [)" + edits + "]}}";
+    };
+
+    // targets directly below the datastore root are built straight from the parsed value
+    auto topLevel = yangPatch("top-level", [](int i) {
+        auto name = "e" + std::to_string(i);
+        return R"({"edit-id": ")" + name + R"(", "operation": "create", "target": "/example:top-level-list=)" + name
+            + R"(", "value": {"example:top-level-list": [{"name": ")" + name + R"("}]}})";
+    });
+    // nested targets need their parents, so their values are re-parsed below the target's parent
+    auto nested = yangPatch("nested", [](int i) {
+        auto name = "e" + std::to_string(i);
+        return R"({"edit-id": ")" + name + R"(", "operation": "create", "target": "/example:tlc/list=)" + name
+            + R"(", "value": {"example:list": [{"name": ")" + name + R"(", "choice1": "x"}]}})";
+    });
+
+    auto measure = [](const std::string& body) {
+        auto start = Clock::now();
+        auto response = clientRequest("PATCH", RESTCONF_DATA_ROOT, body, {AUTH_ROOT, CONTENT_TYPE_YANG_PATCH_JSON}, boost::posix_time::minutes(5));
+        auto elapsed = Clock::now() - start;
+        REQUIRE(response.statusCode == 200);
+        return std::chrono::duration<double, std::micro>{elapsed}.count() / numEdits;
+    };
+
+    auto topLevelUs = measure(topLevel);
+    auto nestedUs = measure(nested);
+
+    spdlog::info("{} edits in a single YANG patch: {:.1f} us per edit for top-level targets ({} bytes), "
+                 "{:.1f} us per edit for nested targets ({} bytes)",
+                 numEdits, topLevelUs, topLevel.size(), nestedUs, nested.size());
+}
+
+TEST_CASE("selecting fields of a large list")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numEntries = 2'000;
+    constexpr auto numRequests = 20;
+
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    auto nacmGuard = manageNacm(srSess);
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    setupRealNacm(srSess);
+
+    populateLargeList(srSess, numEntries);
+
+    auto measure = [](const std::string& uri) {
+        std::size_t bytes = 0;
+        auto start = Clock::now();
+        for (int i = 0; i < numRequests; ++i) {
+            auto response = get(uri, {AUTH_ROOT});
+            REQUIRE(response.statusCode == 200);
+            bytes = response.data.size();
+        }
+        return std::pair{std::chrono::duration<double, std::milli>{Clock::now() - start}.count() / numRequests, bytes};
+    };
+
+    auto [everythingMs, everythingBytes] = measure(RESTCONF_DATA_ROOT "/example:tlc");
+    auto [fieldsMs, fieldsBytes] = measure(RESTCONF_DATA_ROOT "/example:tlc?fields=list/name");
+
+    spdlog::info("{} list entries: the whole list {} bytes in {:.1f} ms, only the keys via fields {} bytes in {:.1f} ms; "
+                 "{:.1f}% less data, {:.1f}% less time",
+                 numEntries, everythingBytes, everythingMs, fieldsBytes, fieldsMs,
+                 100.0 * (everythingBytes - fieldsBytes) / everythingBytes, 100.0 * (everythingMs - fieldsMs) / everythingMs);
+}
+
+TEST_CASE("XPath filter on the server vs. on the client")
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr auto numEntries = 2'000;
+    constexpr auto numRequests = 20;
+    const auto filter = "/example:tlc/list[name='entry-42']/choice1"s;
+
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    auto nacmGuard = manageNacm(srSess);
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    setupRealNacm(srSess);
+    populateLargeList(srSess, numEntries);
+
+    // the server reads everything with NACM applied either way, the filter only saves the transfer and the client's parsing
+    std::size_t serverBytes = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < numRequests; ++i) {
+        auto response = get(RESTCONF_DATA_ROOT "/example:tlc?rousette-filter=" + filter, {AUTH_ROOT});
+        REQUIRE(response.statusCode == 200);
+        serverBytes = response.data.size();
+    }
+    auto serverSide = Clock::now() - start;
+
+    std::size_t clientBytes = 0;
+    start = Clock::now();
+    for (int i = 0; i < numRequests; ++i) {
+        auto response = get(RESTCONF_DATA_ROOT "/example:tlc", {AUTH_ROOT});
+        REQUIRE(response.statusCode == 200);
+        clientBytes = response.data.size();
+        auto data = srSess.getContext().parseData(response.data, libyang::DataFormat::JSON, libyang::ParseOptions::ParseOnly);
+        REQUIRE(data->findXPath(filter).size() == 1);
+    }
+    auto clientSide = Clock::now() - start;
+
+    spdlog::info("{} list entries, one node selected: filtered by the server {} bytes in {:.1f} ms, by the client {} bytes in {:.1f} ms",
+                 numEntries,
+                 serverBytes, std::chrono::duration<double, std::milli>{serverSide}.count() / numRequests,
+                 clientBytes, std::chrono::duration<double, std::milli>{clientSide}.count() / numRequests);
+}
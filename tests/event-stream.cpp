@@ -0,0 +1,474 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include "trompeloeil_doctest.h"
+#include <array>
+#include <chrono>
+#include <vector>
+#include <zlib.h>
+#include "http/Broadcast.h"
+#include "http/EventStream.h"
+
+namespace {
+std::string drainAll(rousette::http::EventQueue& queue, std::size_t chunkSize)
+{
+    std::string res;
+    std::vector<uint8_t> buf(chunkSize);
+    while (!queue.empty()) {
+        auto written = queue.drain(buf.data(), buf.size());
+        REQUIRE(written > 0);
+        res.append(reinterpret_cast<const char*>(buf.data()), written);
+    }
+    return res;
+}
+}
+
+TEST_CASE("event stream framing")
+{
+    using rousette::http::sseFrame;
+
+    REQUIRE(sseFrame("") == "\n");
+    REQUIRE(sseFrame("hello") == "data: hello\n\n");
+    REQUIRE(sseFrame("hello\n") == "data: hello\n\n");
+    REQUIRE(sseFrame("a\nb") == "data: a\ndata: b\n\n");
+    REQUIRE(sseFrame("a\n\nb\n") == "data: a\ndata: \ndata: b\n\n");
+    REQUIRE(sseFrame("\na") == "data: \ndata: a\n\n");
+    REQUIRE(sseFrame(R"({
+  "foo": "bar"
+}
+)") == "data: {\ndata:   \"foo\": \"bar\"\ndata: }\n\n");
+
+    // heartbeats are comments which the clients ignore
+    REQUIRE(rousette::http::Event::heartbeat()->frame(rousette::http::Framing::Sse) == ":\n\n");
+    REQUIRE(!rousette::http::Event::heartbeat()->id);
+}
+
+TEST_CASE("broadcast")
+{
+    rousette::http::Broadcast<int> broadcast;
+    std::vector<int> a, b;
+
+    auto connA = broadcast.connect([&a](int x) { a.push_back(x); });
+    {
+        rousette::http::ScopedConnection connB = broadcast.connect([&b](int x) { b.push_back(x); });
+        REQUIRE(broadcast.size() == 2);
+        broadcast(1);
+    }
+    REQUIRE(broadcast.size() == 1);
+    broadcast(2);
+    connA.disconnect();
+    REQUIRE(!connA.connected());
+    REQUIRE(broadcast.size() == 0);
+    broadcast(3);
+    connA.disconnect();
+
+    REQUIRE(a == std::vector{1, 2});
+    REQUIRE(b == std::vector{1});
+
+    // a subscriber can disconnect itself, and new ones only get values which are published after they have connected
+    rousette::http::ScopedConnection self;
+    self = broadcast.connect([&](int x) {
+        a.push_back(x);
+        self.disconnect();
+        auto late = broadcast.connect([&b](int x) { b.push_back(x); });
+    });
+    broadcast(4);
+    broadcast(5);
+    REQUIRE(a == std::vector{1, 2, 4});
+    REQUIRE(b == std::vector{1, 5});
+}
+
+TEST_CASE("gzip compression")
+{
+    rousette::http::GzipStream gzip;
+
+    z_stream inflater{};
+    REQUIRE(inflateInit2(&inflater, 15 + 16) == Z_OK);
+    auto decompress = [&inflater](std::string compressed) {
+        std::string res(65536, '\0');
+        inflater.next_in = reinterpret_cast<Bytef*>(compressed.data());
+        inflater.avail_in = compressed.size();
+        inflater.next_out = reinterpret_cast<Bytef*>(res.data());
+        inflater.avail_out = res.size();
+        REQUIRE(inflate(&inflater, Z_SYNC_FLUSH) == Z_OK);
+        REQUIRE(inflater.avail_in == 0);
+        res.resize(res.size() - inflater.avail_out);
+        return res;
+    };
+
+    // every event can be decompressed as soon as it arrives, and the repeated parts are much cheaper the next time
+    std::size_t firstSize = 0;
+    for (int i = 0; i < 10; ++i) {
+        auto frame = rousette::http::sseFrame(R"({"ietf-restconf:notification": {"eventTime": "2024-01-01T00:00:00Z", "example:eventA": {"progress": )" + std::to_string(i) + "}}}");
+        auto compressed = gzip.compress(frame);
+        if (i == 0) {
+            firstSize = compressed.size();
+        } else {
+            REQUIRE(compressed.size() < firstSize / 2);
+        }
+        REQUIRE(decompress(compressed) == frame);
+    }
+    inflateEnd(&inflater);
+}
+
+TEST_CASE("batched events")
+{
+    using rousette::http::makeEvent;
+    using rousette::http::sseFrame;
+
+    rousette::http::Batching json{.maxEvents = 0, .window = std::chrono::milliseconds{100}, .prefix = "[", .separator = ",", .suffix = "]"};
+    rousette::http::Batching xml{.maxEvents = 0, .window = std::chrono::milliseconds{100}, .prefix = "<wrapper>", .separator = "", .suffix = "</wrapper>"};
+
+    auto batch = rousette::http::Event::batch({makeEvent("{\n  \"a\": 1\n}\n", 1), makeEvent("{\"b\": 2}", 2)}, json);
+    REQUIRE(batch->id == 2);
+    REQUIRE(batch->frame(rousette::http::Framing::Sse) == "id: 2\ndata: [\ndata: {\ndata:   \"a\": 1\ndata: }\ndata: ,\ndata: {\"b\": 2}\ndata: ]\n\n");
+
+    batch = rousette::http::Event::batch({makeEvent("<a/>"), makeEvent("<b/>")}, xml);
+    REQUIRE(!batch->id);
+    REQUIRE(batch->frame(rousette::http::Framing::Sse) == sseFrame("<wrapper>\n<a/>\n<b/>\n</wrapper>"));
+
+    // the batch is resumed after its last event which has an ID
+    batch = rousette::http::Event::batch({makeEvent("x", 10), makeEvent("y")}, xml);
+    REQUIRE(batch->id == 10);
+    REQUIRE(batch->frame(rousette::http::Framing::Sse) == sseFrame("<wrapper>\nx\ny\n</wrapper>", 10));
+}
+
+TEST_CASE("length-prefixed frames")
+{
+    using rousette::http::Event;
+    using rousette::http::Framing;
+    using rousette::http::makeEvent;
+
+    auto event = makeEvent("{\n  \"a\": 1\n}\n", 0x0102);
+    REQUIRE(event->message == "{\n  \"a\": 1\n}\n");
+    REQUIRE(event->size(Framing::LengthPrefixed) == Event::BinaryHeaderSize + event->message.size());
+    REQUIRE(event->size(Framing::Sse) == event->frame(Framing::Sse).size());
+
+    auto header = event->binaryHeader();
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(event->time.time_since_epoch()).count();
+    REQUIRE(header == std::array<uint8_t, Event::BinaryHeaderSize>{
+                0, 0, 0, 13,
+                0x01, 0, 0, 0,
+                0, 0, 0, 0, 0, 0, 0x01, 0x02,
+                static_cast<uint8_t>(micros >> 56), static_cast<uint8_t>(micros >> 48), static_cast<uint8_t>(micros >> 40), static_cast<uint8_t>(micros >> 32),
+                static_cast<uint8_t>(micros >> 24), static_cast<uint8_t>(micros >> 16), static_cast<uint8_t>(micros >> 8), static_cast<uint8_t>(micros)});
+
+    // no ID, and a heartbeat is just a header with nothing else
+    REQUIRE(makeEvent("x")->binaryHeader()[4] == 0);
+    REQUIRE(Event::heartbeat()->binaryHeader() == std::array<uint8_t, Event::BinaryHeaderSize>{});
+    REQUIRE(Event::heartbeat()->size(Framing::LengthPrefixed) == Event::BinaryHeaderSize);
+
+    auto expected = [](const rousette::http::EventPtr& event) {
+        auto header = event->binaryHeader();
+        return std::string(header.begin(), header.end()) + event->message;
+    };
+
+    // each framing is built just once, and then shared
+    REQUIRE(event->frame(Framing::LengthPrefixed) == expected(event));
+    REQUIRE(&event->frame(Framing::LengthPrefixed) == &event->frame(Framing::LengthPrefixed));
+    REQUIRE(Event::heartbeat()->frame(Framing::LengthPrefixed) == std::string(Event::BinaryHeaderSize, '\0'));
+
+    rousette::http::EventQueue queue{{}, Framing::LengthPrefixed};
+    auto another = makeEvent("");
+    queue.push(event);
+    queue.push(another);
+    REQUIRE(queue.bytes() == 2 * Event::BinaryHeaderSize + event->message.size());
+
+    SECTION("everything at once")
+    {
+        REQUIRE(drainAll(queue, 100) == expected(event) + expected(another));
+    }
+
+    SECTION("byte by byte")
+    {
+        REQUIRE(drainAll(queue, 1) == expected(event) + expected(another));
+    }
+
+    SECTION("a chunk which ends within the header")
+    {
+        REQUIRE(drainAll(queue, 7) == expected(event) + expected(another));
+    }
+
+    // the batch carries the joined messages, without any SSE framing
+    rousette::http::Batching json{.maxEvents = 0, .window = std::chrono::milliseconds{100}, .prefix = "[", .separator = ",", .suffix = "]"};
+    auto batch = Event::batch({makeEvent("{\"a\": 1}", 1), makeEvent("{\"b\": 2}", 2)}, json);
+    REQUIRE(batch->message == R"([{"a": 1},{"b": 2}])");
+    REQUIRE(batch->binaryHeader()[15] == 2);
+}
+
+TEST_CASE("event history")
+{
+    using rousette::http::sseFrame;
+
+    REQUIRE(sseFrame("hello", 42) == "id: 42\ndata: hello\n\n");
+
+    rousette::http::EventHistory history{3};
+    auto frames = [](const std::optional<std::vector<rousette::http::EventPtr>>& events) {
+        std::vector<std::string> res;
+        for (const auto& event : events.value()) {
+            res.push_back(event->frame(rousette::http::Framing::Sse));
+        }
+        return res;
+    };
+
+    REQUIRE(history.lastId() == 0);
+    REQUIRE(frames(history.after(0)).empty());
+    REQUIRE(history.after(1) == std::nullopt);
+
+    REQUIRE(history.push("a")->frame(rousette::http::Framing::Sse) == "id: 1\ndata: a\n\n");
+    history.push("b");
+    REQUIRE(history.lastId() == 2);
+    REQUIRE(frames(history.after(0)) == std::vector<std::string>{sseFrame("a", 1), sseFrame("b", 2)});
+    REQUIRE(frames(history.after(1)) == std::vector<std::string>{sseFrame("b", 2)});
+    REQUIRE(frames(history.after(2)).empty());
+
+    history.push("c");
+    history.push("d");
+    // "a" is gone
+    REQUIRE(history.after(0) == std::nullopt);
+    REQUIRE(frames(history.after(1)) == std::vector<std::string>{sseFrame("b", 2), sseFrame("c", 3), sseFrame("d", 4)});
+
+    history.clear();
+    REQUIRE(history.after(3) == std::nullopt);
+    REQUIRE(frames(history.after(4)).empty());
+    REQUIRE(history.push("e")->id == 5);
+    REQUIRE(frames(history.after(4)) == std::vector<std::string>{sseFrame("e", 5)});
+
+    history.skip();
+    REQUIRE(history.lastId() == 6);
+    REQUIRE(history.after(5) == std::nullopt);
+    REQUIRE(frames(history.after(6)).empty());
+
+    // IDs of another history are unknown here
+    rousette::http::EventHistory another{3, 1'000};
+    REQUIRE(another.push("f")->id == 1'001);
+    REQUIRE(another.after(5) == std::nullopt);
+    REQUIRE(another.after(6) == std::nullopt);
+    REQUIRE(history.after(1'001) == std::nullopt);
+
+    // a history which has run out of its IDs moves on to another range, where nothing from the old one is known
+    another.restart(5'000);
+    REQUIRE(another.lastId() == 5'000);
+    REQUIRE(another.after(1'001) == std::nullopt);
+    REQUIRE(frames(another.after(5'000)).empty());
+    REQUIRE(another.push("g")->id == 5'001);
+}
+
+TEST_CASE("event queue")
+{
+    using rousette::http::makeEvent;
+    using rousette::http::sseFrame;
+
+    rousette::http::EventQueue queue;
+    REQUIRE(queue.empty());
+    REQUIRE(queue.bytes() == 0);
+
+    queue.push(makeEvent("a"));
+    queue.push(makeEvent("b"));
+    queue.push(makeEvent(""));
+    queue.push(makeEvent("c"));
+    const auto everything = sseFrame("a") + sseFrame("b") + sseFrame("") + sseFrame("c");
+    REQUIRE(queue.size() == 4);
+    REQUIRE(queue.bytes() == everything.size());
+
+    SECTION("everything at once")
+    {
+        REQUIRE(drainAll(queue, 100) == everything);
+    }
+
+    SECTION("partial writes")
+    {
+        std::array<uint8_t, 5> buf;
+        REQUIRE(queue.drain(buf.data(), buf.size()) == 5);
+        REQUIRE(std::string(buf.begin(), buf.end()) == everything.substr(0, 5));
+        REQUIRE(queue.size() == 4);
+        REQUIRE(queue.bytes() == everything.size() - 5);
+
+        REQUIRE(queue.drain(buf.data(), buf.size()) == 5);
+        REQUIRE(std::string(buf.begin(), buf.end()) == everything.substr(5, 5));
+        REQUIRE(queue.size() == 3);
+        REQUIRE(queue.bytes() == everything.size() - 10);
+
+        queue.push(makeEvent("d"));
+        REQUIRE(queue.bytes() == everything.size() - 10 + sseFrame("d").size());
+        REQUIRE(drainAll(queue, 3) == everything.substr(10) + sseFrame("d"));
+    }
+
+    SECTION("byte by byte")
+    {
+        REQUIRE(drainAll(queue, 1) == everything);
+    }
+
+    SECTION("one event shared by several queues")
+    {
+        rousette::http::EventQueue another;
+        auto event = makeEvent("e");
+        another.push(event);
+        queue.push(event);
+        REQUIRE(event.use_count() == 3);
+        REQUIRE(drainAll(another, 100) == sseFrame("e"));
+        REQUIRE(drainAll(queue, 100) == everything + sseFrame("e"));
+        REQUIRE(event.use_count() == 1);
+    }
+
+    REQUIRE(queue.empty());
+    REQUIRE(queue.bytes() == 0);
+}
+
+TEST_CASE("event queue limits with a reader that never drains")
+{
+    using rousette::http::OverflowPolicy;
+    constexpr auto numEvents = 1000;
+    auto message = [](int i) { return "event #" + std::to_string(i); };
+    auto event = [&message](int i) { return rousette::http::makeEvent(message(i)); };
+    auto frame = [&message](int i) { return rousette::http::sseFrame(message(i)); };
+
+    SECTION("no limits")
+    {
+        rousette::http::EventQueue queue;
+        for (int i = 0; i < numEvents; ++i) {
+            REQUIRE(queue.push(event(i)).dropped == 0);
+        }
+        REQUIRE(queue.size() == numEvents);
+    }
+
+    SECTION("drop oldest")
+    {
+        SECTION("by number of events")
+        {
+            rousette::http::EventQueue queue{{.maxEvents = 3, .maxBytes = 0, .policy = OverflowPolicy::DropOldest}};
+            std::size_t dropped = 0;
+            for (int i = 0; i < numEvents; ++i) {
+                auto res = queue.push(event(i));
+                REQUIRE(!res.disconnect);
+                dropped += res.dropped;
+                REQUIRE(queue.size() <= 3);
+            }
+            REQUIRE(dropped == numEvents - 3);
+            REQUIRE(drainAll(queue, 100) == frame(997) + frame(998) + frame(999));
+        }
+
+        SECTION("by size")
+        {
+            rousette::http::EventQueue queue{{.maxEvents = 0, .maxBytes = 40, .policy = OverflowPolicy::DropOldest}};
+            for (int i = 0; i < numEvents; ++i) {
+                queue.push(event(i));
+                REQUIRE(queue.bytes() <= 40);
+            }
+            REQUIRE(drainAll(queue, 100) == frame(998) + frame(999));
+        }
+
+        SECTION("a partially sent event is kept")
+        {
+            rousette::http::EventQueue queue{{.maxEvents = 2, .maxBytes = 0, .policy = OverflowPolicy::DropOldest}};
+            queue.push(event(0));
+            std::array<uint8_t, 3> buf;
+            REQUIRE(queue.drain(buf.data(), buf.size()) == 3);
+            for (int i = 1; i < numEvents; ++i) {
+                queue.push(event(i));
+            }
+            REQUIRE(queue.size() == 2);
+            REQUIRE(drainAll(queue, 100) == frame(0).substr(3) + frame(999));
+        }
+
+        SECTION("the latest event is always accepted")
+        {
+            rousette::http::EventQueue queue{{.maxEvents = 0, .maxBytes = 5, .policy = OverflowPolicy::DropOldest}};
+            REQUIRE(queue.push(event(0)).dropped == 0);
+            REQUIRE(queue.push(event(1)).dropped == 1);
+            REQUIRE(drainAll(queue, 100) == frame(1));
+        }
+    }
+
+    SECTION("coalesce to the latest event")
+    {
+        rousette::http::EventQueue queue{{.maxEvents = 2, .maxBytes = 0, .policy = OverflowPolicy::CoalesceLatest}};
+        REQUIRE(queue.push(event(0)).dropped == 0);
+        REQUIRE(queue.push(event(1)).dropped == 0);
+        REQUIRE(queue.push(event(2)).dropped == 2);
+        for (int i = 3; i < numEvents; ++i) {
+            queue.push(event(i));
+            REQUIRE(queue.size() <= 2);
+        }
+        REQUIRE(drainAll(queue, 100) == frame(998) + frame(999));
+    }
+
+    SECTION("disconnect")
+    {
+        rousette::http::EventQueue queue{{.maxEvents = 10, .maxBytes = 0, .policy = OverflowPolicy::Disconnect}};
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(!queue.push(event(i)).disconnect);
+        }
+        REQUIRE(queue.push(event(10)).disconnect);
+    }
+}
+
+TEST_CASE("event stream statistics")
+{
+    rousette::http::StreamStatistics stats;
+    REQUIRE(stats.asJSON() == R"({
+  "event-streams": {}
+}
+)");
+
+    auto optics = stats.counters("/telemetry/optics");
+    REQUIRE(stats.counters("/telemetry/optics") == optics);
+    ++optics->clients;
+    optics->queuedEvents += 2;
+    optics->queuedBytes += 100;
+    optics->droppedEvents += 5;
+    ++optics->reaped;
+    auto netconf = stats.counters("/streams/NETCONF/JSON");
+    ++netconf->disconnects;
+    netconf->memoryReplays += 2;
+    netconf->memoryReplayMicroseconds += 300;
+    ++netconf->storedReplays;
+    netconf->storedReplayMicroseconds += 20'000;
+
+    REQUIRE(stats.asJSON() == R"({
+  "event-streams": {
+    "/streams/NETCONF/JSON": {
+      "clients": 0,
+      "queued-events": 0,
+      "queued-bytes": 0,
+      "dropped-events": 0,
+      "disconnects": 1,
+      "reaped": 0,
+      "replays": {
+        "from-memory": 2,
+        "from-memory-average-us": 150,
+        "from-storage": 1,
+        "from-storage-average-us": 20000
+      }
+    },
+    "/telemetry/optics": {
+      "clients": 1,
+      "queued-events": 2,
+      "queued-bytes": 100,
+      "dropped-events": 5,
+      "disconnects": 0,
+      "reaped": 1
+    }
+  }
+}
+)");
+
+    // stream names are escaped as JSON strings
+    rousette::http::StreamStatistics weird;
+    weird.counters("/streams/\"quoted\"\\\n");
+    REQUIRE(weird.asJSON() == R"({
+  "event-streams": {
+    "/streams/\"quoted\"\\\u000a": {
+      "clients": 0,
+      "queued-events": 0,
+      "queued-bytes": 0,
+      "dropped-events": 0,
+      "disconnects": 0,
+      "reaped": 0
+    }
+  }
+}
+)");
+}
@@ -86,3 +86,36 @@ TEST_CASE("Get Host from forwarded")
     REQUIRE(rousette::http::parseForwardedHeader("host=proto=https") == ProtoAndHost{});
     REQUIRE(rousette::http::parseForwardedHeader("") == ProtoAndHost{});
 }
+
+TEST_CASE("Last-Event-ID")
+{
+    using rousette::http::lastEventId;
+    auto headers = [](const std::string& value) {
+        return nghttp2::asio_http2::header_map{{"last-event-id", {value, false}}};
+    };
+
+    REQUIRE(lastEventId({}) == std::nullopt);
+    REQUIRE(lastEventId(headers("42")) == 42);
+    REQUIRE(lastEventId(headers("0")) == 0);
+    REQUIRE(lastEventId(headers("")) == std::nullopt);
+    REQUIRE(lastEventId(headers("-1")) == std::nullopt);
+    REQUIRE(lastEventId(headers("4 2")) == std::nullopt);
+    REQUIRE(lastEventId(headers("99999999999999999999999")) == std::nullopt);
+}
+
+TEST_CASE("Accept-Encoding")
+{
+    using rousette::http::acceptsEncoding;
+    auto headers = [](const std::string& value) {
+        return nghttp2::asio_http2::header_map{{"accept-encoding", {value, false}}};
+    };
+
+    REQUIRE(!acceptsEncoding({}, "gzip"));
+    REQUIRE(acceptsEncoding(headers("gzip"), "gzip"));
+    REQUIRE(acceptsEncoding(headers("deflate, GZIP;q=0.5, br"), "gzip"));
+    REQUIRE(!acceptsEncoding(headers("deflate, br"), "gzip"));
+    REQUIRE(!acceptsEncoding(headers("gzip;q=0"), "gzip"));
+    REQUIRE(acceptsEncoding(headers("*"), "gzip"));
+    REQUIRE(!acceptsEncoding(headers("*, gzip;q=0"), "gzip"));
+    REQUIRE(!acceptsEncoding(headers("gzip;q=x"), "gzip"));
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include "trompeloeil_doctest.h"
+#include <libyang-cpp/Context.hpp>
+#include "restconf/NotificationStream.h"
+#include "tests/configure.cmake.h"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("notification replay buffer")
+{
+    auto ctx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+    ctx.loadModule("example", std::nullopt, {"f1"});
+
+    const auto t0 = sysrepo::NotificationTimeStamp{std::chrono::seconds{1'000}};
+    const std::set<std::string> example{"example"};
+    const std::set<std::string> exampleAndOther{"example", "example-notif"};
+
+    uint64_t lastId = 0;
+    auto entry = [&](const sysrepo::NotificationTimeStamp& time) {
+        auto notification = *ctx.newPath("/example:eventB");
+        ++lastId;
+        return rousette::restconf::NotificationReplayBuffer::Entry{lastId, time, notification};
+    };
+
+    SECTION("disabled")
+    {
+        rousette::restconf::NotificationReplayBuffer buffer{0};
+        buffer.startRecording(example, t0, 1);
+        buffer.push(entry(t0 + 1s));
+        REQUIRE(buffer.entries().empty());
+        REQUIRE(!buffer.covers(example, t0 + 1s));
+        REQUIRE(!buffer.coversAfter(example, 0));
+    }
+
+    SECTION("coverage")
+    {
+        rousette::restconf::NotificationReplayBuffer buffer{2};
+
+        // nothing is known about modules which are not recorded
+        REQUIRE(!buffer.covers(example, t0));
+        REQUIRE(!buffer.coversAfter(example, 0));
+        buffer.startRecording(example, t0, 1);
+        REQUIRE(buffer.covers(example, t0));
+        REQUIRE(buffer.coversAfter(example, 0));
+        REQUIRE(buffer.covers(example, t0 + 10s));
+        REQUIRE(!buffer.covers(example, t0 - 1s));
+        REQUIRE(!buffer.covers(exampleAndOther, t0 + 10s));
+
+        // recording a module again does not reset it
+        buffer.startRecording(exampleAndOther, t0 + 5s, 3);
+        REQUIRE(buffer.covers(example, t0));
+        REQUIRE(!buffer.covers(exampleAndOther, t0));
+        REQUIRE(buffer.covers(exampleAndOther, t0 + 5s));
+        REQUIRE(!buffer.coversAfter(exampleAndOther, 1));
+        REQUIRE(buffer.coversAfter(exampleAndOther, 2));
+
+        buffer.push(entry(t0 + 1s));
+        buffer.push(entry(t0 + 2s));
+        REQUIRE(buffer.entries().size() == 2);
+        REQUIRE(buffer.covers(example, t0));
+
+        // the oldest notification is gone, so the buffer is complete only after its time
+        buffer.push(entry(t0 + 3s));
+        REQUIRE(buffer.entries().size() == 2);
+        REQUIRE(buffer.entries().front().time == t0 + 2s);
+        REQUIRE(!buffer.covers(example, t0));
+        REQUIRE(!buffer.covers(example, t0 + 1s));
+        REQUIRE(buffer.covers(example, t0 + 1s + 1ms));
+        REQUIRE(!buffer.coversAfter(example, 0));
+        REQUIRE(buffer.coversAfter(example, 1));
+        REQUIRE(buffer.coversAfter(example, 3));
+        REQUIRE(buffer.entries().back().id == 3);
+
+        // serialized only when asked for, and just once
+        const auto& newest = buffer.entries().back();
+        auto json = newest.event(ctx, libyang::DataFormat::JSON);
+        REQUIRE(json->frame(rousette::http::Framing::Sse).starts_with("id: 3\ndata: {"));
+        REQUIRE(json->frame(rousette::http::Framing::Sse).find(R"("example:eventB")") != std::string::npos);
+        REQUIRE(newest.event(ctx, libyang::DataFormat::JSON) == json);
+        REQUIRE(newest.event(ctx, libyang::DataFormat::XML)->frame(rousette::http::Framing::Sse).starts_with("id: 3\ndata: <notification"));
+    }
+}
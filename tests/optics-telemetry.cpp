@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include "trompeloeil_doctest.h"
+#include <libyang-cpp/Context.hpp>
+#include "sr/OpticalEvents.h"
+#include "tests/configure.cmake.h"
+
+using namespace std::string_literals;
+
+namespace {
+libyang::Context exampleContext()
+{
+    auto ctx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+    ctx.loadModule("example", std::nullopt, {"f1"});
+    return ctx;
+}
+}
+
+TEST_CASE("optics telemetry patches")
+{
+    using rousette::sr::asResourceIdentifier;
+    using rousette::sr::asYangPatch;
+    using rousette::sr::DataChange;
+
+    auto ctx = exampleContext();
+    auto tree = *ctx.newPath("/example:tlc/list[name='a b,c']/choice1", "old");
+    tree.newPath("/example:tlc/list[name='a b,c']/nested[first='1'][second='2'][third='3']");
+    tree.newPath("/example:tlc/list[name='a b,c']/collection", "42");
+    tree.newPath("/example:tlc/list[name='x']/choice1", "new");
+    tree.newPath("/example:top-level-leaf", "moo");
+
+    auto choice1 = *tree.findPath("/example:tlc/list[name='a b,c']/choice1");
+    auto listX = *tree.findPath("/example:tlc/list[name='x']");
+
+    SECTION("resource identifiers")
+    {
+        REQUIRE(asResourceIdentifier(choice1) == "/example:tlc/list=a%20b%2Cc/choice1");
+        REQUIRE(asResourceIdentifier(listX) == "/example:tlc/list=x");
+        REQUIRE(asResourceIdentifier(*tree.findPath("/example:tlc/list[name='a b,c']/nested[first='1'][second='2'][third='3']")) == "/example:tlc/list=a%20b%2Cc/nested=1,2,3");
+        REQUIRE(asResourceIdentifier(*tree.findPath("/example:tlc/list[name='a b,c']/collection[.='42']")) == "/example:tlc/list=a%20b%2Cc/collection=42");
+        REQUIRE(asResourceIdentifier(*tree.findPath("/example:top-level-leaf")) == "/example:top-level-leaf");
+    }
+
+    SECTION("changes")
+    {
+        tree.newPath("/example:tlc/list[name='a b,c']/choice1", "changed", libyang::CreationOptions::Update);
+        std::vector<DataChange> changes{
+            {sysrepo::ChangeOperation::Modified, choice1},
+            // sysrepo reports all descendants of a created node, these are not repeated in the patch
+            {sysrepo::ChangeOperation::Created, listX},
+            {sysrepo::ChangeOperation::Created, *listX.findPath("name")},
+            {sysrepo::ChangeOperation::Created, *listX.findPath("choice1")},
+            {sysrepo::ChangeOperation::Deleted, *tree.findPath("/example:top-level-leaf")},
+        };
+
+        REQUIRE(asYangPatch("1", changes) == R"({"patch-id":"1","edit":[)"
+                                             R"({"edit-id":"1","operation":"replace","target":"/example:tlc/list=a%20b%2Cc/choice1","value":{"example:choice1":"changed"}},)"
+                                             R"({"edit-id":"2","operation":"create","target":"/example:tlc/list=x","value":{"example:list":[{"name":"x","choice1":"new"}]}},)"
+                                             R"({"edit-id":"3","operation":"delete","target":"/example:top-level-leaf"})"
+                                             R"(]})");
+
+        REQUIRE(asYangPatch("2", {}) == R"({"patch-id":"2","edit":[]})");
+    }
+
+    SECTION("coalesced changes")
+    {
+        tree.newPath("/example:tlc/list[name='a b,c']/choice1", "changed", libyang::CreationOptions::Update);
+        tree.findPath("/example:top-level-leaf")->unlink();
+        std::map<std::string, std::string> changedNodes{
+            {"/example:tlc/list[name='a b,c']/choice1", "/example:tlc/list=a%20b%2Cc/choice1"},
+            // covered by its parent
+            {"/example:tlc/list[name='x']", "/example:tlc/list=x"},
+            {"/example:tlc/list[name='x']/choice1", "/example:tlc/list=x/choice1"},
+            // does not exist anymore
+            {"/example:top-level-leaf", "/example:top-level-leaf"},
+            {"/example:two-leafs/a", "/example:two-leafs/a"},
+        };
+
+        REQUIRE(asYangPatch("3", tree, changedNodes) == R"({"patch-id":"3","edit":[)"
+                                                        R"({"edit-id":"1","operation":"replace","target":"/example:tlc/list=a%20b%2Cc/choice1","value":{"example:choice1":"changed"}},)"
+                                                        R"({"edit-id":"2","operation":"replace","target":"/example:tlc/list=x","value":{"example:list":[{"name":"x","choice1":"new"}]}},)"
+                                                        R"({"edit-id":"3","operation":"remove","target":"/example:top-level-leaf"},)"
+                                                        R"({"edit-id":"4","operation":"remove","target":"/example:two-leafs/a"})"
+                                                        R"(]})");
+    }
+}
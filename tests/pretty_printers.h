@@ -137,6 +137,19 @@ struct StringMaker<rousette::restconf::PathSegment> {
     }
 };
 
+template <>
+struct StringMaker<rousette::restconf::queryParams::fields::Field> {
+    static String convert(const rousette::restconf::queryParams::fields::Field& obj)
+    {
+        std::string ret = "Field{";
+        ret += StringMaker<decltype(obj.path)>::convert(obj.path).c_str();
+        ret += " children=";
+        ret += StringMaker<decltype(obj.children)>::convert(obj.children).c_str();
+        ret += "}";
+        return ret.c_str();
+    }
+};
+
 template <>
 struct StringMaker<rousette::restconf::queryParams::QueryParamValue> {
     static String convert(const rousette::restconf::queryParams::QueryParamValue& obj)
@@ -159,6 +172,12 @@ struct StringMaker<rousette::restconf::queryParams::QueryParamValue> {
             [](const rousette::restconf::queryParams::insert::PointParsed& p) -> std::string {
                 return ("PointParsed{" + StringMaker<decltype(p)>::convert(p) + "}").c_str();
             },
+            [](const rousette::restconf::queryParams::fields::Expr& expr) -> std::string {
+                return ("Fields{" + StringMaker<decltype(expr)>::convert(expr) + "}").c_str();
+            },
+            [](const rousette::restconf::queryParams::limit::Unbounded&) -> std::string { return "Unbounded{}"; },
+            [](const rousette::restconf::queryParams::direction::Forwards&) -> std::string { return "Forwards{}"; },
+            [](const rousette::restconf::queryParams::direction::Backwards&) -> std::string { return "Backwards{}"; },
         }, obj).c_str();
     }
 };
@@ -7,13 +7,17 @@
 
 #include "trompeloeil_doctest.h"
 static const auto SERVER_PORT = "10088";
+#include <cstdlib>
+#include <filesystem>
 #include <latch>
 #include <libyang-cpp/Time.hpp>
 #include <nghttp2/asio_http2.h>
 #include <spdlog/spdlog.h>
 #include <sysrepo-cpp/utils/utils.hpp>
+#include "restconf/NotificationStream.h"
 #include "restconf/Server.h"
 #include "tests/aux-utils.h"
+#include "tests/configure.cmake.h"
 #include "tests/pretty_printers.h"
 
 #define EXPECT_NOTIFICATION(DATA, SEQ) expectations.emplace_back(NAMED_REQUIRE_CALL(netconfWatcher, data(DATA)).IN_SEQUENCE(SEQ));
@@ -117,6 +121,8 @@ struct SSEClient {
         while (std::getline(iss, line)) {
             if (line.compare(0, prefix.size(), prefix) == 0) {
                 event += line.substr(prefix.size());
+            } else if (line.starts_with("id: ")) {
+                // event IDs for Last-Event-ID, not a part of the event data
             } else if (line.empty()) {
                 res.emplace_back(std::move(event));
                 event.clear();
@@ -169,7 +175,7 @@ TEST_CASE("NETCONF notification streams")
     srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
 
     auto nacmGuard = manageNacm(srSess);
-    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT, 0ms, {}, {.perModule = true, .filtered = {{"selected", "/example:eventA | /example-notif:something-happened"}}}};
     setupRealNacm(srSess);
 
     // parent for nested notification
@@ -237,6 +243,46 @@ TEST_CASE("NETCONF notification streams")
             }
         }
 
+        SECTION("Per-module streams")
+        {
+            SECTION("anonymous user, including nested notifications")
+            {
+                uri = "/streams/example/JSON";
+                EXPECT_NOTIFICATION(notificationsJSON[0], seqMod1);
+                EXPECT_NOTIFICATION(notificationsJSON[1], seqMod1);
+                EXPECT_NOTIFICATION(notificationsJSON[3], seqMod1);
+                EXPECT_NOTIFICATION(notificationsJSON[4], seqMod1);
+            }
+
+            SECTION("root user")
+            {
+                netconfWatcher.setDataFormat(libyang::DataFormat::XML);
+                headers = {AUTH_ROOT};
+                uri = "/streams/example-notif/XML";
+                EXPECT_NOTIFICATION(notificationsJSON[2], seqMod2);
+            }
+        }
+
+        SECTION("Stream with a fixed filter")
+        {
+            headers = {AUTH_ROOT};
+
+            SECTION("No filter")
+            {
+                uri = "/streams/selected/JSON";
+                EXPECT_NOTIFICATION(notificationsJSON[0], seqMod1);
+                EXPECT_NOTIFICATION(notificationsJSON[2], seqMod2);
+                EXPECT_NOTIFICATION(notificationsJSON[3], seqMod1);
+            }
+
+            SECTION("Both filters apply")
+            {
+                uri = "/streams/selected/JSON?filter=/example:eventA";
+                EXPECT_NOTIFICATION(notificationsJSON[0], seqMod1);
+                EXPECT_NOTIFICATION(notificationsJSON[3], seqMod1);
+            }
+        }
+
         PREPARE_LOOP_WITH_EXCEPTIONS
 
         // Here's how these two threads work together.
@@ -275,6 +321,57 @@ TEST_CASE("NETCONF notification streams")
         RUN_LOOP_WITH_EXCEPTIONS;
     }
 
+    SECTION("Several clients with different users, formats and filters")
+    {
+        NotificationWatcher anonymousWatcher(srConn.sessionStart().getContext());
+        anonymousWatcher.setDataFormat(libyang::DataFormat::JSON);
+        netconfWatcher.setDataFormat(libyang::DataFormat::XML);
+
+        EXPECT_NOTIFICATION(notificationsJSON[0], seqMod1);
+        EXPECT_NOTIFICATION(notificationsJSON[1], seqMod1);
+        EXPECT_NOTIFICATION(notificationsJSON[2], seqMod2);
+        EXPECT_NOTIFICATION(notificationsJSON[3], seqMod1);
+        EXPECT_NOTIFICATION(notificationsJSON[4], seqMod1);
+
+        // anonymous user cannot read example-notif, and the filter selects just eventA
+        trompeloeil::sequence seqAnonymous;
+        expectations.emplace_back(NAMED_REQUIRE_CALL(anonymousWatcher, data(notificationsJSON[0])).IN_SEQUENCE(seqAnonymous));
+        expectations.emplace_back(NAMED_REQUIRE_CALL(anonymousWatcher, data(notificationsJSON[3])).IN_SEQUENCE(seqAnonymous));
+
+        boost::asio::io_service io;
+        std::promise<void> bg;
+        std::latch requestSent(2);
+
+        std::jthread notificationThread = std::jthread(wrap_exceptions_and_asio(bg, io, [&]() {
+            auto notifSession = sysrepo::Connection{}.sessionStart();
+            auto ctx = notifSession.getContext();
+
+            requestSent.wait();
+
+            for (const auto& notification : notificationsJSON) {
+                SEND_NOTIFICATION(notification);
+            }
+
+            waitForCompletionAndBitMore(seqMod1);
+            waitForCompletionAndBitMore(seqMod2);
+            waitForCompletionAndBitMore(seqAnonymous);
+        }));
+
+        SSEClient cliRoot(io, requestSent, netconfWatcher, "/streams/NETCONF/XML", {AUTH_ROOT});
+        SSEClient cliAnonymous(io, requestSent, anonymousWatcher, "/streams/NETCONF/JSON?filter=/example:eventA", {});
+        RUN_LOOP_WITH_EXCEPTIONS;
+    }
+
+    SECTION("Modules with notifications")
+    {
+        auto modules = rousette::restconf::notificationModules(srSess.getContext());
+        REQUIRE(modules.contains("example")); // top-level ones and a nested one in a list
+        REQUIRE(modules.contains("example-notif"));
+        REQUIRE(modules.contains("example-augment")); // nested in a container from an augment
+        REQUIRE(!modules.contains("example-delete"));
+        REQUIRE(!modules.contains("ietf-system"));
+    }
+
     SECTION("Other methods")
     {
         REQUIRE(clientRequest("HEAD", "/streams/NETCONF/XML", "", {AUTH_ROOT}) == Response{200, eventStreamHeaders, ""});
@@ -296,11 +393,17 @@ TEST_CASE("NETCONF notification streams")
         REQUIRE(get("/streams/NETCONF/", {}) == Response{404, plaintextHeaders, "Invalid stream"});
         REQUIRE(get("/streams/NETCONF/", {AUTH_ROOT}) == Response{404, plaintextHeaders, "Invalid stream"});
         REQUIRE(get("/streams/NETCONF/bla", {}) == Response{404, plaintextHeaders, "Invalid stream"});
+        REQUIRE(get("/streams/bla/XML", {}) == Response{404, plaintextHeaders, "Invalid stream"});
+        REQUIRE(get("/streams/example-delete/XML", {AUTH_ROOT}) == Response{404, plaintextHeaders, "Invalid stream"}); // no notifications in there
+        REQUIRE(get("/streams/ietf-system/JSON", {AUTH_ROOT}) == Response{404, plaintextHeaders, "Invalid stream"});
     }
 
     SECTION("Invalid parameters")
     {
-        REQUIRE(get("/streams/NETCONF/XML?filter=.878", {}) == Response{400, plaintextHeaders, "Couldn't create notification subscription: SR_ERR_INVAL_ARG\n XPath \".878\" does not select any notifications. (SR_ERR_INVAL_ARG)"});
+        REQUIRE(get("/streams/NETCONF/XML?filter=.878", {}) == Response{400, plaintextHeaders, "XPath \".878\" does not select any notifications."});
+        REQUIRE(get("/streams/NETCONF/XML?filter=/example:tlc", {}) == Response{400, plaintextHeaders, "XPath \"/example:tlc\" does not select any notifications."});
+        // replays subscribe in sysrepo directly
+        REQUIRE(get("/streams/NETCONF/XML?filter=.878&start-time=2000-01-01T00:00:00+00:00", {}) == Response{400, plaintextHeaders, "Couldn't create notification subscription: SR_ERR_INVAL_ARG\n XPath \".878\" does not select any notifications. (SR_ERR_INVAL_ARG)"});
         REQUIRE(get("/streams/NETCONF/XML?filter=", {}) == Response{400, plaintextHeaders, "Query parameters syntax error"});
 
         REQUIRE(get("/streams/NETCONF/XML?start-time=2000-01-01T00:00:00+00:00&stop-time=1990-01-01T00:00:00+00:00", {}) == Response{400, plaintextHeaders, "stop-time must be greater than start-time"});
@@ -308,6 +411,65 @@ TEST_CASE("NETCONF notification streams")
         REQUIRE(get("/streams/NETCONF/XML?start-time=" + libyang::yangTimeFormat(std::chrono::system_clock::now() + std::chrono::hours(1), libyang::TimezoneInterpretation::Local), {}) == Response{400, plaintextHeaders, "start-time is in the future"});
     }
 
+    SECTION("Stream list")
+    {
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-restconf-monitoring:restconf-state/streams/stream=example-notif", {AUTH_ROOT, FORWARDED}) == Response{200, jsonHeaders, R"({
+  "ietf-restconf-monitoring:restconf-state": {
+    "streams": {
+      "stream": [
+        {
+          "name": "example-notif",
+          "description": "Notifications from YANG module example-notif",
+          "access": [
+            {
+              "encoding": "xml",
+              "location": "http://example.net/streams/example-notif/XML"
+            },
+            {
+              "encoding": "json",
+              "location": "http://example.net/streams/example-notif/JSON"
+            }
+          ]
+        }
+      ]
+    }
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-restconf-monitoring:restconf-state/streams/stream=selected", {AUTH_ROOT, FORWARDED}) == Response{200, jsonHeaders, R"({
+  "ietf-restconf-monitoring:restconf-state": {
+    "streams": {
+      "stream": [
+        {
+          "name": "selected",
+          "description": "Notifications selected by XPath /example:eventA | /example-notif:something-happened",
+          "access": [
+            {
+              "encoding": "xml",
+              "location": "http://example.net/streams/selected/XML"
+            },
+            {
+              "encoding": "json",
+              "location": "http://example.net/streams/selected/JSON"
+            }
+          ]
+        }
+      ]
+    }
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-restconf-monitoring:restconf-state/streams/stream=example-delete", {AUTH_ROOT, FORWARDED}).statusCode == 404);
+
+        // replay support of a per-module stream depends just on that module
+        srConn.setModuleReplaySupport("example", true);
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-restconf-monitoring:restconf-state/streams/stream=example/replay-support", {AUTH_ROOT, FORWARDED}).statusCode == 200);
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-restconf-monitoring:restconf-state/streams/stream=example-notif/replay-support", {AUTH_ROOT, FORWARDED}).statusCode == 404);
+        srConn.setModuleReplaySupport("example", false);
+    }
+
     SECTION("Replays")
     {
         // no replays so sending a notification does not trigger replay-* leafs
@@ -436,4 +598,31 @@ TEST_CASE("NETCONF notification streams")
         SSEClient cli(io, requestSent, netconfWatcher, uri, {AUTH_ROOT});
         RUN_LOOP_WITH_EXCEPTIONS;
     }
+
+    // this one has to be the last one; the module stays installed
+    SECTION("Module installed while a stream is open")
+    {
+        // unlike sysrepo's one, this context knows the new module from the start
+        auto lateCtx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+        lateCtx.loadModule("example-late-notif");
+        NotificationWatcher lateWatcher(lateCtx);
+        expectations.emplace_back(NAMED_REQUIRE_CALL(lateWatcher, data(R"({"example-late-notif:installed":{}})")).IN_SEQUENCE(seqMod1));
+
+        PREPARE_LOOP_WITH_EXCEPTIONS
+
+        std::jthread notificationThread = std::jthread(wrap_exceptions_and_asio(bg, io, [&]() {
+            requestSent.wait();
+            REQUIRE(std::system(SYSREPOCTL_EXECUTABLE " --install " CMAKE_CURRENT_SOURCE_DIR "/tests/yang/example-late-notif.yang") == 0);
+            std::this_thread::sleep_for(500ms); // the server subscribes to the new module once sysrepo announces it
+
+            auto notifSession = sysrepo::Connection{}.sessionStart();
+            auto ctx = notifSession.getContext();
+            SEND_NOTIFICATION(R"({"example-late-notif:installed":{}})");
+
+            waitForCompletionAndBitMore(seqMod1);
+        }));
+
+        SSEClient cli(io, requestSent, lateWatcher, "/streams/NETCONF/JSON", {AUTH_ROOT});
+        RUN_LOOP_WITH_EXCEPTIONS;
+    }
 }
@@ -72,7 +72,9 @@ TEST_CASE("reading data")
         "urn:ietf:params:restconf:capability:defaults:1.0?basic-mode=explicit",
         "urn:ietf:params:restconf:capability:depth:1.0",
         "urn:ietf:params:restconf:capability:with-defaults:1.0",
-        "urn:ietf:params:restconf:capability:filter:1.0"
+        "urn:ietf:params:restconf:capability:filter:1.0",
+        "urn:ietf:params:restconf:capability:list-pagination:1.0",
+        "urn:ietf:params:restconf:capability:fields:1.0"
       ]
     },
     "streams": {
@@ -116,7 +118,9 @@ TEST_CASE("reading data")
         "urn:ietf:params:restconf:capability:defaults:1.0?basic-mode=explicit",
         "urn:ietf:params:restconf:capability:depth:1.0",
         "urn:ietf:params:restconf:capability:with-defaults:1.0",
-        "urn:ietf:params:restconf:capability:filter:1.0"
+        "urn:ietf:params:restconf:capability:filter:1.0",
+        "urn:ietf:params:restconf:capability:list-pagination:1.0",
+        "urn:ietf:params:restconf:capability:fields:1.0"
       ]
     },
     "streams": {
@@ -563,7 +567,9 @@ TEST_CASE("reading data")
         "urn:ietf:params:restconf:capability:defaults:1.0?basic-mode=explicit",
         "urn:ietf:params:restconf:capability:depth:1.0",
         "urn:ietf:params:restconf:capability:with-defaults:1.0",
-        "urn:ietf:params:restconf:capability:filter:1.0"
+        "urn:ietf:params:restconf:capability:filter:1.0",
+        "urn:ietf:params:restconf:capability:list-pagination:1.0",
+        "urn:ietf:params:restconf:capability:fields:1.0"
       ]
     },
     "streams": {
@@ -785,6 +791,408 @@ TEST_CASE("reading data")
 )"});
     }
 
+    SECTION("fields query param")
+    {
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-system:system?fields=contact;radius/server(udp/address)", {AUTH_DWDM}) == Response{200, jsonHeaders, R"({
+  "ietf-system:system": {
+    "contact": "contact",
+    "radius": {
+      "server": [
+        {
+          "name": "a",
+          "udp": {
+            "address": "1.1.1.1"
+          }
+        }
+      ]
+    }
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "?fields=example:config-nonconfig/config-node", {}) == Response{200, jsonHeaders, R"({
+  "example:config-nonconfig": {
+    "config-node": "foo-config-true"
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:config-nonconfig?fields=nonconfig-node&content=config", {}) == Response{404, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "application",
+        "error-tag": "invalid-value",
+        "error-message": "No data from sysrepo."
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:config-nonconfig?fields=nonexistent", {}) == Response{400, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "protocol",
+        "error-tag": "invalid-value",
+        "error-message": "Query parameter 'fields' refers to '/example:config-nonconfig/nonexistent' which is not a schema node"
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:config-nonconfig?fields=(", {}) == Response{400, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "protocol",
+        "error-tag": "invalid-value",
+        "error-message": "Query parameters syntax error"
+      }
+    ]
+  }
+}
+)"});
+    }
+
+    SECTION("rousette-filter query param")
+    {
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-system:system?rousette-filter=/ietf-system:system/radius/server[udp/address='1.1.1.1']/udp/address", {AUTH_DWDM}) == Response{200, jsonHeaders, R"({
+  "ietf-system:system": {
+    "radius": {
+      "server": [
+        {
+          "name": "a",
+          "udp": {
+            "address": "1.1.1.1"
+          }
+        }
+      ]
+    }
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-system:system?rousette-filter=/ietf-system:system[clock/timezone-utc-offset=2]/contact", {AUTH_DWDM}) == Response{200, jsonHeaders, R"({
+  "ietf-system:system": {
+    "contact": "contact"
+  }
+}
+)"});
+
+        // anonymous user cannot read the clock, so the predicate cannot reveal anything about it
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-system:system?rousette-filter=/ietf-system:system[clock/timezone-utc-offset=2]/contact", {}) == Response{404, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "application",
+        "error-tag": "invalid-value",
+        "error-message": "No data from sysrepo."
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/ietf-system:system?rousette-filter=/ietf-system:system[hostname='hostname']/contact", {}) == Response{200, jsonHeaders, R"({
+  "ietf-system:system": {
+    "contact": "contact"
+  }
+}
+)"});
+    }
+
+    SECTION("list pagination")
+    {
+        srSess.switchDatastore(sysrepo::Datastore::Running);
+        srSess.setItem("/example:tlc/list[name='a']/choice1", "z");
+        srSess.setItem("/example:tlc/list[name='b']/choice1", "y");
+        srSess.setItem("/example:tlc/list[name='c']/choice1", "x");
+        srSess.setItem("/example:tlc/list[name='d']/choice1", "w");
+        srSess.applyChanges();
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?limit=2", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "a",
+        "choice1": "z"
+      },
+      {
+        "name": "b",
+        "choice1": "y"
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?offset=1&limit=2", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "b",
+        "choice1": "y"
+      },
+      {
+        "name": "c",
+        "choice1": "x"
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?direction=backwards&limit=1", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "d",
+        "choice1": "w"
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?where=choice1!='y'&limit=2", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "a",
+        "choice1": "z"
+      },
+      {
+        "name": "c",
+        "choice1": "x"
+      }
+    ]
+  }
+}
+)"});
+
+        // the entries are selected from the sorted list, and they are returned in that order
+        srSess.setItem("/example:ordered-lists/lst[name='b']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/lst[name='d']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/lst[name='a']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/lst[name='c']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/ll[.='3']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/ll[.='10']", std::nullopt);
+        srSess.setItem("/example:ordered-lists/ll[.='2']", std::nullopt);
+        srSess.applyChanges();
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:ordered-lists/lst?sort-by=name&limit=3", {}) == Response{200, jsonHeaders, R"({
+  "example:ordered-lists": {
+    "lst": [
+      {
+        "name": "a"
+      },
+      {
+        "name": "b"
+      },
+      {
+        "name": "c"
+      }
+    ]
+  }
+}
+)"});
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:ordered-lists/lst?sort-by=name&direction=backwards&offset=1&limit=2", {}) == Response{200, jsonHeaders, R"({
+  "example:ordered-lists": {
+    "lst": [
+      {
+        "name": "c"
+      },
+      {
+        "name": "b"
+      }
+    ]
+  }
+}
+)"});
+
+        // without sort-by, the backwards direction just reverses the order of the list
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:ordered-lists/lst?direction=backwards&limit=3", {}) == Response{200, jsonHeaders, R"({
+  "example:ordered-lists": {
+    "lst": [
+      {
+        "name": "c"
+      },
+      {
+        "name": "a"
+      },
+      {
+        "name": "d"
+      }
+    ]
+  }
+}
+)"});
+
+        // numbers are sorted as numbers
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:ordered-lists/ll?sort-by=.", {}) == Response{200, jsonHeaders, R"({
+  "example:ordered-lists": {
+    "ll": [
+      "2",
+      "3",
+      "10"
+    ]
+  }
+}
+)"});
+
+        // the sort key is only used for sorting, it is not returned unless the fields ask for it
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?sort-by=choice1&limit=1&fields=name", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "d"
+      }
+    ]
+  }
+}
+)"});
+
+        // a window past the end of the list is empty, but the list exists
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?offset=10", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {}
+}
+)"});
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?sort-by=choice1&offset=10", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {}
+}
+)"});
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:top-level-list?offset=1", {}) == Response{404, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "application",
+        "error-tag": "invalid-value",
+        "error-message": "No data from sysrepo."
+      }
+    ]
+  }
+}
+)"});
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?offset=10", {{"accept", "application/yang-data+xml"}}) == Response{200, xmlHeaders, R"(<tlc xmlns="http://example.tld/example"/>
+)"});
+        REQUIRE(head(RESTCONF_DATA_ROOT "/example:tlc/list?offset=10", {}) == Response{200, jsonHeaders, ""});
+
+        // a top-level list has no ancestors, so the client gets an empty datastore resource
+        srSess.setItem("/example:top-level-list[name='a']", std::nullopt);
+        srSess.applyChanges();
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:top-level-list?offset=1", {}) == Response{200, jsonHeaders, R"({
+  "ietf-restconf:data": {}
+}
+)"});
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:top-level-list?offset=1", {{"accept", "application/yang-data+xml"}}) == Response{200, xmlHeaders, R"(<data xmlns="urn:ietf:params:xml:ns:yang:ietf-restconf"/>
+)"});
+
+        // entries and nodes which the user may not read are neither counted nor can they be matched by the predicate
+        srSess.moveItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']", sysrepo::MovePosition::Before, "[name='13']");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/module-name", "example");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/action", "deny");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/access-operations", "read");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/path", "/example:tlc/list[name='b']");
+        srSess.moveItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13b']", sysrepo::MovePosition::Before, "[name='13']");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13b']/module-name", "example");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13b']/action", "deny");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13b']/access-operations", "read");
+        srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13b']/path", "/example:tlc/list[name='d']/choice1");
+        srSess.applyChanges();
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?limit=2", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "a",
+        "choice1": "z"
+      },
+      {
+        "name": "c",
+        "choice1": "x"
+      }
+    ]
+  }
+}
+)"});
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list?direction=backwards&limit=1", {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {
+    "list": [
+      {
+        "name": "d"
+      }
+    ]
+  }
+}
+)"});
+        for (const auto& where : {"name='b'", "choice1='y'", "choice1='w'"}) {
+            CAPTURE(where);
+            REQUIRE(get(std::string{RESTCONF_DATA_ROOT "/example:tlc/list?where="} + where, {}) == Response{200, jsonHeaders, R"({
+  "example:tlc": {}
+}
+)"});
+        }
+
+        // the predicate cannot select anything outside of the list
+        for (const auto& where : {"true()]%7C/ietf-system:system/*[true()", "true()%7C/ietf-system:system", "name='a", "name=="}) {
+            CAPTURE(where);
+            REQUIRE(get(std::string{RESTCONF_DATA_ROOT "/example:tlc/list?where="} + where, {}) == Response{400, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "protocol",
+        "error-tag": "invalid-value",
+        "error-message": "Query parameter 'where' is not a valid XPath predicate"
+      }
+    ]
+  }
+}
+)"});
+        }
+
+        REQUIRE(get(RESTCONF_DATA_ROOT "/example:tlc/list=a?limit=1", {}) == Response{400, jsonHeaders, R"({
+  "ietf-restconf:errors": {
+    "error": [
+      {
+        "error-type": "protocol",
+        "error-tag": "invalid-value",
+        "error-message": "List pagination query parameters can be used only with a list or a leaf-list target"
+      }
+    ]
+  }
+}
+)"});
+    }
+
+    SECTION("HEAD and content-length")
+    {
+        auto resp = get(RESTCONF_DATA_ROOT "/ietf-system:system/clock", {AUTH_DWDM});
+        REQUIRE(resp == Response{200, jsonHeaders, R"({
+  "ietf-system:system": {
+    "clock": {
+      "timezone-utc-offset": 2
+    }
+  }
+}
+)"});
+        REQUIRE(resp.headers.count("content-length") == 1);
+        REQUIRE(resp.headers.find("content-length")->second.value == std::to_string(resp.data.size()));
+
+        // HEAD only checks that the data exist, it does not print them, so there is no length to announce (RFC 9110, sec. 8.6)
+        auto headResp = head(RESTCONF_DATA_ROOT "/ietf-system:system/clock", {AUTH_DWDM});
+        REQUIRE(headResp == Response{200, jsonHeaders, ""});
+        REQUIRE(headResp.equalStatusCodeAndHeaders(resp));
+        REQUIRE(headResp.headers.count("content-length") == 0);
+
+        REQUIRE(head(RESTCONF_DATA_ROOT "/ietf-system:system/radius/server=b", {AUTH_DWDM}) == Response{404, jsonHeaders, ""});
+        // NACM still applies, anonymous users cannot read the clock
+        REQUIRE(head(RESTCONF_DATA_ROOT "/ietf-system:system/clock", {}) == Response{404, jsonHeaders, ""});
+    }
+
     SECTION("OPTIONS method")
     {
         // RPC node
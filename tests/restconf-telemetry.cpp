@@ -0,0 +1,671 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+static const auto SERVER_PORT = "10091";
+#include "tests/aux-utils.h"
+#include <array>
+#include <condition_variable>
+#include <future>
+#include <nghttp2/asio_http2.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <zlib.h>
+#include "restconf/Server.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+/** @short A client of an event stream which reads in the background, and which keeps everything it has received */
+class StreamReader {
+public:
+    StreamReader(const std::string& uri, const std::map<std::string, std::string>& headers)
+        : m_client(std::make_shared<ng_client::session>(m_io, SERVER_ADDRESS, SERVER_PORT))
+    {
+        ng::header_map reqHeaders;
+        for (const auto& [name, value] : headers) {
+            reqHeaders.insert({name, {value, false}});
+        }
+
+        m_client->on_connect([this, uri, reqHeaders](auto) {
+            boost::system::error_code ec;
+            auto req = m_client->submit(ec, "GET", SERVER_ADDRESS_AND_PORT + uri, "", reqHeaders);
+            req->on_response([this](const ng_client::response& res) {
+                {
+                    std::lock_guard lock{m_mtx};
+                    m_statusCode = res.status_code();
+                    m_headers = res.header();
+                }
+                m_cv.notify_all();
+                res.on_data([this](const uint8_t* data, std::size_t len) {
+                    {
+                        std::lock_guard lock{m_mtx};
+                        m_data.append(reinterpret_cast<const char*>(data), len);
+                    }
+                    m_cv.notify_all();
+                });
+            });
+            req->on_close([this](auto) {
+                {
+                    std::lock_guard lock{m_mtx};
+                    m_closed = true;
+                }
+                m_cv.notify_all();
+                m_client->shutdown();
+            });
+        });
+        m_client->on_error([this](const boost::system::error_code&) {
+            {
+                std::lock_guard lock{m_mtx};
+                m_closed = true;
+            }
+            m_cv.notify_all();
+        });
+
+        m_thread = std::jthread{[this]() { m_io.run(); }};
+    }
+
+    ~StreamReader()
+    {
+        disconnect();
+    }
+
+    /** @short Goes away, just like a real client which closes the connection */
+    void disconnect()
+    {
+        resume();
+        m_io.post([client = m_client]() { client->shutdown(); });
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    /** @short Stops reading from the socket until resume(), like a client which is stuck */
+    void pause()
+    {
+        m_paused = true;
+        m_io.post([future = m_resume.get_future()]() { future.wait(); });
+    }
+
+    void resume()
+    {
+        if (m_paused) {
+            m_paused = false;
+            m_resume.set_value();
+        }
+    }
+
+    /** @short Waits until everything received so far satisfies the predicate, or until the timeout */
+    bool waitFor(const std::function<bool(const std::string& data)>& predicate, std::chrono::milliseconds timeout = 3s)
+    {
+        std::unique_lock lock{m_mtx};
+        return m_cv.wait_for(lock, timeout, [&]() { return predicate(m_data); });
+    }
+
+    bool waitForEvents(std::size_t count, std::chrono::milliseconds timeout = 3s)
+    {
+        return waitFor([count](const auto& data) { return parseEvents(data).size() >= count; }, timeout);
+    }
+
+    /** @short Waits for the response headers; once these are here, the server has subscribed this client to its events */
+    bool waitForResponse(std::chrono::milliseconds timeout = 3s)
+    {
+        std::unique_lock lock{m_mtx};
+        return m_cv.wait_for(lock, timeout, [&]() { return m_statusCode.has_value(); });
+    }
+
+    bool waitForClose(std::chrono::milliseconds timeout = 3s)
+    {
+        std::unique_lock lock{m_mtx};
+        return m_cv.wait_for(lock, timeout, [&]() { return m_closed; });
+    }
+
+    std::optional<int> statusCode() const
+    {
+        std::lock_guard lock{m_mtx};
+        return m_statusCode;
+    }
+
+    ng::header_map headers() const
+    {
+        std::lock_guard lock{m_mtx};
+        return m_headers;
+    }
+
+    std::string data() const
+    {
+        std::lock_guard lock{m_mtx};
+        return m_data;
+    }
+
+    bool closed() const
+    {
+        std::lock_guard lock{m_mtx};
+        return m_closed;
+    }
+
+    std::vector<std::string> events() const
+    {
+        std::lock_guard lock{m_mtx};
+        return parseEvents(m_data);
+    }
+
+    /** @short The messages of a text/event-stream, i.e., the contents of their `data:` lines */
+    static std::vector<std::string> parseEvents(const std::string& data)
+    {
+        std::vector<std::string> res;
+        std::string event;
+        bool hasData = false;
+        std::istringstream iss(data);
+        std::string line;
+        while (std::getline(iss, line)) {
+            if (line.starts_with("data: ")) {
+                event += line.substr(6);
+                hasData = true;
+            } else if (line.empty() && hasData) {
+                res.emplace_back(std::move(event));
+                event.clear();
+                hasData = false;
+            }
+        }
+        return res;
+    }
+
+private:
+    boost::asio::io_service m_io;
+    std::shared_ptr<ng_client::session> m_client;
+    mutable std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::optional<int> m_statusCode;
+    ng::header_map m_headers;
+    std::string m_data;
+    bool m_closed = false;
+    bool m_paused = false;
+    std::promise<void> m_resume;
+    std::jthread m_thread;
+};
+
+/** @short Number of sysrepo change subscriptions to the module in the datastore, as reported by sysrepo itself */
+std::size_t changeSubscriptions(sysrepo::Connection conn, const std::string& module, const std::string& datastore)
+{
+    auto sess = conn.sessionStart(sysrepo::Datastore::Operational);
+    const auto xpath = "/sysrepo-monitoring:sysrepo-state/module[name='" + module + "']/subscriptions/change-sub[datastore='" + datastore + "']";
+    auto data = sess.getData(xpath);
+    return data ? data->findXPath(xpath).size() : 0;
+}
+
+/** @short Waits until the number of change subscriptions is as expected; these go away asynchronously, after the client has */
+bool waitForChangeSubscriptions(sysrepo::Connection conn, const std::string& module, const std::string& datastore, std::size_t expected)
+{
+    for (auto deadline = std::chrono::steady_clock::now() + 3s; std::chrono::steady_clock::now() < deadline; std::this_thread::sleep_for(10ms)) {
+        if (changeSubscriptions(conn, module, datastore) == expected) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool contains(const std::string& haystack, const std::string& needle)
+{
+    return haystack.find(needle) != std::string::npos;
+}
+
+/** @short Everything which can be decompressed from a gzip stream so far */
+std::string gunzip(std::string compressed)
+{
+    z_stream inflater{};
+    if (inflateInit2(&inflater, 15 + 16) != Z_OK) {
+        throw std::runtime_error{"inflateInit2 failed"};
+    }
+    inflater.next_in = reinterpret_cast<Bytef*>(compressed.data());
+    inflater.avail_in = compressed.size();
+
+    std::string res;
+    std::array<char, 16384> buf;
+    do {
+        inflater.next_out = reinterpret_cast<Bytef*>(buf.data());
+        inflater.avail_out = buf.size();
+        if (auto ret = inflate(&inflater, Z_SYNC_FLUSH); ret != Z_OK && ret != Z_BUF_ERROR) {
+            break;
+        }
+        res.append(buf.data(), buf.size() - inflater.avail_out);
+    } while (inflater.avail_out == 0);
+    inflateEnd(&inflater);
+    return res;
+}
+
+/** @short Waits until /telemetry/statistics report something; the counters are updated asynchronously */
+bool waitForStatistics(const std::string& needle, std::chrono::milliseconds timeout = 5s)
+{
+    for (auto deadline = std::chrono::steady_clock::now() + timeout; std::chrono::steady_clock::now() < deadline; std::this_thread::sleep_for(100ms)) {
+        if (contains(get("/telemetry/statistics", {}).data, needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+TEST_CASE("periodic telemetry")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    srSess.setItem("/ietf-system:system/location", "prague");
+    srSess.applyChanges();
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    // the next aligned tick is far away, so the data are there right when the client connects
+    const auto uri = "/telemetry/periodic?xpath=/ietf-system:system/location&datastore=ietf-datastores:running&period=3600000"s;
+    StreamReader client(uri, {AUTH_DWDM});
+    REQUIRE(client.waitForEvents(1));
+    REQUIRE(client.statusCode() == 200);
+    REQUIRE(contains(client.events()[0], R"("ietf-yang-push:push-update")"));
+    REQUIRE(contains(client.events()[0], R"("prague")"));
+
+    // a client which joins an existing subscription gets the current data as well
+    StreamReader another(uri, {AUTH_DWDM});
+    REQUIRE(another.waitForEvents(1));
+    REQUIRE(contains(another.events()[0], R"("prague")"));
+}
+
+TEST_CASE("on-change telemetry")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    const auto running = "ietf-datastores:running"s;
+    const auto uri = "/telemetry/on-change?xpath=/ietf-system:system&datastore=" + running;
+    const auto before = changeSubscriptions(srConn, "ietf-system", running);
+
+    SECTION("an edit produces a YANG Patch")
+    {
+        {
+            StreamReader client(uri, {AUTH_DWDM});
+            REQUIRE(client.waitForEvents(1));
+            REQUIRE(client.statusCode() == 200);
+            REQUIRE(contains(client.events()[0], R"("ietf-yang-push:push-update")"));
+
+            // a single sysrepo subscription, no matter how many clients there are
+            StreamReader another(uri, {AUTH_DWDM});
+            REQUIRE(another.waitForEvents(1));
+            REQUIRE(changeSubscriptions(srConn, "ietf-system", running) == before + 1);
+
+            srSess.switchDatastore(sysrepo::Datastore::Running);
+            srSess.setItem("/ietf-system:system/location", "prague");
+            srSess.applyChanges();
+
+            REQUIRE(client.waitForEvents(2));
+            auto patch = client.events()[1];
+            REQUIRE(contains(patch, R"("ietf-yang-push:push-change-update")"));
+            REQUIRE(contains(patch, R"("patch-id":"1")"));
+            REQUIRE(contains(patch, R"("operation":"create","target":"/ietf-system:system/location")"));
+            REQUIRE(contains(patch, R"("prague")"));
+
+            srSess.setItem("/ietf-system:system/location", "brno");
+            srSess.applyChanges();
+            REQUIRE(client.waitForEvents(3));
+            REQUIRE(contains(client.events()[2], R"("operation":"replace","target":"/ietf-system:system/location")"));
+            REQUIRE(contains(client.events()[2], R"("brno")"));
+
+            srSess.deleteItem("/ietf-system:system/location");
+            srSess.applyChanges();
+            REQUIRE(client.waitForEvents(4));
+            REQUIRE(contains(client.events()[3], R"("operation":"delete","target":"/ietf-system:system/location")"));
+        }
+
+        // the last client has gone away, and so has the sysrepo subscription
+        REQUIRE(waitForChangeSubscriptions(srConn, "ietf-system", running, before));
+    }
+
+    SECTION("NACM filters the patches of each user")
+    {
+        StreamReader dwdm(uri, {AUTH_DWDM});
+        StreamReader anonymous(uri, {});
+        REQUIRE(dwdm.waitForEvents(1));
+        REQUIRE(anonymous.waitForEvents(1));
+
+        srSess.switchDatastore(sysrepo::Datastore::Running);
+        srSess.setItem("/ietf-system:system/clock/timezone-utc-offset", "2");
+        srSess.applyChanges();
+        srSess.setItem("/ietf-system:system/location", "prague");
+        srSess.applyChanges();
+
+        REQUIRE(dwdm.waitForEvents(3));
+        REQUIRE(contains(dwdm.events()[1], R"("target":"/ietf-system:system/clock/timezone-utc-offset")"));
+        REQUIRE(contains(dwdm.events()[2], R"("target":"/ietf-system:system/location")"));
+
+        // the anonymous user may not read the clock, so the first change does not exist for them
+        REQUIRE(anonymous.waitForEvents(2));
+        REQUIRE(contains(anonymous.events()[1], R"("patch-id":"1")"));
+        REQUIRE(contains(anonymous.events()[1], R"("target":"/ietf-system:system/location")"));
+        REQUIRE(!contains(anonymous.data(), "timezone-utc-offset"));
+    }
+}
+
+TEST_CASE("event stream keepalive")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    rousette::restconf::EventStreamLimits limits;
+    limits.keepalive.heartbeat = 1s;
+    limits.keepalive.stallTimeout = 1s;
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT, 0ms, limits};
+    setupRealNacm(srSess);
+
+    const auto uri = "/telemetry/on-change?xpath=/ietf-system:system&datastore=ietf-datastores:running"s;
+
+    SECTION("an idle stream gets comments")
+    {
+        StreamReader client(uri, {AUTH_DWDM});
+        REQUIRE(client.waitForEvents(1));
+
+        // nothing happens in the datastore, so the server has to say something on its own
+        REQUIRE(client.waitFor([](const auto& data) { return contains(data, "\n\n:\n\n"); }));
+        REQUIRE(client.events().size() == 1);
+        REQUIRE(!client.closed());
+    }
+
+    SECTION("a client which stops reading is reaped")
+    {
+        StreamReader client(uri, {AUTH_DWDM});
+        REQUIRE(client.waitForEvents(1));
+        client.pause();
+
+        // more than what fits into the HTTP/2 flow control window, so that the rest stays queued at the server
+        srSess.switchDatastore(sysrepo::Datastore::Running);
+        for (int i = 0; i < 30; ++i) {
+            srSess.setItem("/ietf-system:system/location", std::to_string(i) + std::string(10'000, 'x'));
+            srSess.applyChanges();
+        }
+
+        REQUIRE(waitForStatistics(R"("reaped": 1)"));
+
+        client.resume();
+        REQUIRE(client.waitForClose());
+        REQUIRE(client.events().size() < 31);
+    }
+}
+
+TEST_CASE("rate limits of event streams")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    // the burst is over way sooner than the one second between events which the clients ask for
+    constexpr auto burst = 5;
+
+    SECTION("notifications beyond the rate are dropped")
+    {
+        StreamReader client("/streams/NETCONF/JSON?rousette-max-rate=1", {AUTH_ROOT});
+        REQUIRE(client.waitForResponse());
+        REQUIRE(client.statusCode() == 200);
+
+        auto notify = [&](int progress) {
+            srSess.sendNotification(*srSess.getContext().parseOp(R"({"example:eventA":{"message":"burst","progress":)" + std::to_string(progress) + "}}", libyang::DataFormat::JSON, libyang::OperationType::NotificationYang).op, sysrepo::Wait::No);
+        };
+
+        for (int i = 0; i < burst; ++i) {
+            notify(i);
+        }
+        REQUIRE(client.waitForEvents(1));
+        REQUIRE(waitForStatistics(R"("dropped-events": )" + std::to_string(burst - 1)));
+        REQUIRE(client.events().size() == 1);
+        REQUIRE(contains(client.events()[0], R"("progress":0)"));
+
+        // once the interval has passed, notifications go through again, and the dropped ones are gone for good
+        std::this_thread::sleep_for(1'100ms);
+        notify(99);
+        REQUIRE(client.waitForEvents(2));
+        REQUIRE(contains(client.events()[1], R"("progress":99)"));
+        std::this_thread::sleep_for(200ms);
+        REQUIRE(client.events().size() == 2);
+    }
+
+    SECTION("optics telemetry gets a fresh snapshot instead of the suppressed patches")
+    {
+        auto opticsSess = srConn.sessionStart(sysrepo::Datastore::Operational);
+        auto setPower = [&](const std::string& power) {
+            opticsSess.setItem("/czechlight-roadm-device:aggregate-data/common-in-power", power);
+            opticsSess.applyChanges();
+        };
+        setPower("initial");
+
+        StreamReader client("/telemetry/optics?modules=czechlight-roadm-device&rousette-max-rate=1", {});
+        REQUIRE(client.waitForEvents(1));
+        REQUIRE(contains(client.events()[0], R"("ietf-yang-push:push-update")"));
+        REQUIRE(contains(client.events()[0], R"("initial")"));
+
+        for (int i = 0; i < burst; ++i) {
+            setPower("power " + std::to_string(i));
+        }
+
+        // the first change goes out as a patch, the rest is covered by a single snapshot once the rate allows that
+        REQUIRE(client.waitForEvents(3));
+        auto events = client.events();
+        REQUIRE(contains(events[1], R"("ietf-yang-push:push-change-update")"));
+        REQUIRE(contains(events[1], R"("power 0")"));
+        REQUIRE(contains(events[2], R"("ietf-yang-push:push-update")"));
+        REQUIRE(contains(events[2], R"("power )" + std::to_string(burst - 1) + '"'));
+        std::this_thread::sleep_for(1'100ms);
+        REQUIRE(client.events().size() == 3);
+    }
+}
+
+TEST_CASE("compressed event streams")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    const auto uri = "/telemetry/on-change?xpath=/ietf-system:system&datastore=ietf-datastores:running"s;
+    auto eventsIn = [](const std::string& compressed) { return StreamReader::parseEvents(gunzip(compressed)); };
+
+    StreamReader compressed(uri, {AUTH_DWDM, {"accept-encoding", "gzip, deflate"}});
+    StreamReader plain(uri, {AUTH_DWDM});
+    REQUIRE(compressed.waitFor([&](const auto& data) { return eventsIn(data).size() >= 1; }));
+    REQUIRE(plain.waitForEvents(1));
+
+    auto headers = compressed.headers();
+    REQUIRE(headers.find("content-encoding") != headers.end());
+    REQUIRE(headers.find("content-encoding")->second.value == "gzip");
+    REQUIRE(headers.find("vary")->second.value == "accept, accept-encoding");
+    REQUIRE(!contains(compressed.data(), "ietf-yang-push"));
+    REQUIRE(plain.headers().find("content-encoding") == plain.headers().end());
+
+    srSess.switchDatastore(sysrepo::Datastore::Running);
+    srSess.setItem("/ietf-system:system/location", "prague");
+    srSess.applyChanges();
+
+    // each event can be decompressed as soon as it arrives, and it is the same as what an uncompressed client gets
+    REQUIRE(compressed.waitFor([&](const auto& data) { return eventsIn(data).size() >= 2; }));
+    REQUIRE(plain.waitForEvents(2));
+    auto events = eventsIn(compressed.data());
+    REQUIRE(contains(events[1], R"("ietf-yang-push:push-change-update")"));
+    REQUIRE(contains(events[1], R"("prague")"));
+    REQUIRE(events[1] == plain.events()[1]);
+}
+
+TEST_CASE("optics telemetry watches sysrepo only while needed")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT, 0ms, {}, {}, {.gracePeriod = 1s}};
+    setupRealNacm(srSess);
+
+    const auto operational = "ietf-datastores:operational"s;
+    const auto uri = "/telemetry/optics?modules=czechlight-roadm-device"s;
+    const auto before = changeSubscriptions(srConn, "czechlight-roadm-device", operational);
+
+    {
+        StreamReader client(uri, {});
+        REQUIRE(client.waitForEvents(1));
+        REQUIRE(contains(client.events()[0], R"("ietf-yang-push:push-update")"));
+        REQUIRE(changeSubscriptions(srConn, "czechlight-roadm-device", operational) == before + 1);
+    }
+
+    // a client which comes back within the grace period reuses the subscription
+    {
+        StreamReader client(uri, {});
+        REQUIRE(client.waitForEvents(1));
+        REQUIRE(changeSubscriptions(srConn, "czechlight-roadm-device", operational) == before + 1);
+    }
+
+    // nobody is interested for longer than the grace period
+    REQUIRE(waitForChangeSubscriptions(srConn, "czechlight-roadm-device", operational, before));
+
+    StreamReader client(uri, {});
+    REQUIRE(client.waitForEvents(1));
+    REQUIRE(contains(client.events()[0], R"("ietf-yang-push:push-update")"));
+    REQUIRE(changeSubscriptions(srConn, "czechlight-roadm-device", operational) == before + 1);
+
+    // the new subscription works
+    auto opticsSess = srConn.sessionStart(sysrepo::Datastore::Operational);
+    opticsSess.setItem("/czechlight-roadm-device:aggregate-data/common-in-power", "after a break");
+    opticsSess.applyChanges();
+    REQUIRE(client.waitForEvents(2));
+    REQUIRE(contains(client.events()[1], R"("ietf-yang-push:push-change-update")"));
+    REQUIRE(contains(client.events()[1], R"("after a break")"));
+}
+
+TEST_CASE("optics telemetry sends periodic snapshots")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT, 0ms, {}, {}, {.snapshotInterval = 1s}};
+    setupRealNacm(srSess);
+
+    auto opticsSess = srConn.sessionStart(sysrepo::Datastore::Operational);
+    opticsSess.setItem("/czechlight-roadm-device:aggregate-data/common-in-power", "steady");
+    opticsSess.applyChanges();
+
+    StreamReader client("/telemetry/optics?modules=czechlight-roadm-device", {});
+    REQUIRE(client.waitForEvents(1));
+
+    // nothing changes, and yet the clients get the complete data again
+    REQUIRE(client.waitForEvents(2));
+    auto events = client.events();
+    REQUIRE(contains(events[1], R"("ietf-yang-push:push-update")"));
+    REQUIRE(contains(events[1], R"("steady")"));
+}
+
+TEST_CASE("optics telemetry of selected modules")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    auto opticsSess = srConn.sessionStart(sysrepo::Datastore::Operational);
+    opticsSess.setItem("/czechlight-roadm-device:aggregate-data/common-in-power", "roadm 1");
+    opticsSess.setItem("/czechlight-inline-amp:edfa/gain", "amp 1");
+    opticsSess.applyChanges();
+
+    StreamReader roadm("/telemetry/optics?modules=czechlight-roadm-device", {});
+    StreamReader amp("/telemetry/optics?modules=czechlight-inline-amp", {});
+    REQUIRE(roadm.waitForEvents(1));
+    REQUIRE(amp.waitForEvents(1));
+    REQUIRE(contains(roadm.events()[0], R"("roadm 1")"));
+    REQUIRE(contains(amp.events()[0], R"("amp 1")"));
+
+    opticsSess.setItem("/czechlight-roadm-device:aggregate-data/common-in-power", "roadm 2");
+    opticsSess.applyChanges();
+    opticsSess.setItem("/czechlight-inline-amp:edfa/gain", "amp 2");
+    opticsSess.applyChanges();
+
+    REQUIRE(roadm.waitForEvents(2));
+    REQUIRE(amp.waitForEvents(2));
+    REQUIRE(contains(roadm.events()[1], R"("roadm 2")"));
+    REQUIRE(contains(amp.events()[1], R"("amp 2")"));
+
+    // each client gets just the modules it has asked for
+    std::this_thread::sleep_for(200ms);
+    REQUIRE(roadm.events().size() == 2);
+    REQUIRE(amp.events().size() == 2);
+    REQUIRE(!contains(roadm.data(), "czechlight-inline-amp"));
+    REQUIRE(!contains(amp.data(), "czechlight-roadm-device"));
+
+    SECTION("an event ID of another feed means starting over")
+    {
+        auto lastRoadmId = [&]() {
+            std::string lastId;
+            std::istringstream iss(roadm.data());
+            for (std::string line; std::getline(iss, line);) {
+                if (line.starts_with("id: ")) {
+                    lastId = line.substr(4);
+                }
+            }
+            return lastId;
+        }();
+        REQUIRE(!lastRoadmId.empty());
+
+        StreamReader resumed("/telemetry/optics?modules=czechlight-inline-amp", {{"last-event-id", lastRoadmId}});
+        REQUIRE(resumed.waitForEvents(1));
+        REQUIRE(contains(resumed.events()[0], R"("ietf-yang-push:push-update")"));
+        REQUIRE(contains(resumed.events()[0], R"("amp 2")"));
+    }
+}
+
+TEST_CASE("statistics of event streams")
+{
+    spdlog::set_level(spdlog::level::trace);
+    auto srConn = sysrepo::Connection{};
+    auto srSess = srConn.sessionStart(sysrepo::Datastore::Running);
+    srSess.sendRPC(srSess.getContext().newPath("/ietf-factory-default:factory-reset"));
+    auto nacmGuard = manageNacm(srSess);
+
+    auto server = rousette::restconf::Server{srConn, SERVER_ADDRESS, SERVER_PORT};
+    setupRealNacm(srSess);
+
+    REQUIRE(get("/telemetry/statistics", {}).statusCode == 200);
+    REQUIRE(get("/telemetry/statistics", {AUTH_DWDM}).statusCode == 200);
+    REQUIRE(get("/telemetry/statistics", {AUTH_WRONG_PASSWORD}) == Response{401, plaintextHeaders, "Access denied."});
+
+    // only those who may read the list of the streams get their statistics
+    srSess.moveItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']", sysrepo::MovePosition::Before, "[name='14']");
+    srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/module-name", "ietf-restconf-monitoring");
+    srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/action", "deny");
+    srSess.setItem("/ietf-netconf-acm:nacm/rule-list[name='anon rule']/rule[name='13a']/access-operations", "read");
+    srSess.applyChanges();
+
+    REQUIRE(get("/telemetry/statistics", {}) == Response{403, plaintextHeaders, "Access denied."});
+    REQUIRE(get("/telemetry/statistics", {AUTH_DWDM}).statusCode == 200);
+}
@@ -446,6 +446,86 @@ TEST_CASE("YANG patch")
   }
 }
 )"});
+
+    // top-level targets use the value as parsed from the patch, the same checks apply
+    REQUIRE(patch(RESTCONF_DATA_ROOT, {AUTH_ROOT, CONTENT_TYPE_YANG_PATCH_JSON}, R"({
+  "ietf-yang-patch:yang-patch" : {
+    "patch-id" : "patch",
+    "edit" : [
+      {
+        "edit-id" : "edit",
+        "operation" : "replace",
+        "target" : "/example:top-level-list=libyang",
+        "value" : {
+          "example:top-level-list" : [{
+            "name": "sysrepo"
+          }]
+        }
+      }
+    ]
+  }
+})") == Response{400, jsonHeaders, R"({
+  "ietf-yang-patch:yang-patch-status": {
+    "patch-id": "patch",
+    "edit-status": {
+      "edit": [
+        {
+          "edit-id": "edit",
+          "errors": {
+            "error": [
+              {
+                "error-type": "protocol",
+                "error-tag": "invalid-value",
+                "error-path": "/example:top-level-list[name='sysrepo']/name",
+                "error-message": "List key mismatch between URI path and data."
+              }
+            ]
+          }
+        }
+      ]
+    }
+  }
+}
+)"});
+
+    REQUIRE(patch(RESTCONF_DATA_ROOT, {AUTH_ROOT, CONTENT_TYPE_YANG_PATCH_JSON}, R"({
+  "ietf-yang-patch:yang-patch" : {
+    "patch-id" : "patch",
+    "edit" : [
+      {
+        "edit-id" : "edit",
+        "operation" : "replace",
+        "target" : "/example:top-level-leaf",
+        "value" : {
+          "example:top-level-leaf2" : "hi"
+        }
+      }
+    ]
+  }
+})") == Response{400, jsonHeaders, R"({
+  "ietf-yang-patch:yang-patch-status": {
+    "patch-id": "patch",
+    "edit-status": {
+      "edit": [
+        {
+          "edit-id": "edit",
+          "errors": {
+            "error": [
+              {
+                "error-type": "protocol",
+                "error-tag": "invalid-value",
+                "error-path": "/example:top-level-leaf2",
+                "error-message": "Data contains invalid node."
+              }
+            ]
+          }
+        }
+      ]
+    }
+  }
+}
+)"});
+
     EXPECT_CHANGE(
         CREATED("/example:ordered-lists/ll[.='4']", "4"),
         CREATED("/example:ordered-lists/ll[.='2']", "2"),
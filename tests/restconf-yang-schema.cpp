@@ -232,12 +232,14 @@ TEST_CASE("obtaining YANG schemas")
                         expectedResponseStart = "submodule imp-submod {";
                     }
 
-                    REQUIRE(head(YANG_ROOT "/" + moduleName, {AUTH_ROOT}) == Response{200, yangHeaders, ""});
+                    auto headResp = head(YANG_ROOT "/" + moduleName, {AUTH_ROOT});
+                    REQUIRE(headResp == Response{200, yangHeaders, ""});
 
                     auto resp = get(YANG_ROOT "/" + moduleName, {AUTH_ROOT});
                     auto expectedShortenedResp = Response{200, yangHeaders, expectedResponseStart};
 
                     REQUIRE(resp.equalStatusCodeAndHeaders(expectedShortenedResp));
+                    REQUIRE(headResp.headers.count("content-length") == 0);
                     REQUIRE(resp.data.substr(0, expectedResponseStart.size()) == expectedShortenedResp.data);
                 }
             }
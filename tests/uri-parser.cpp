@@ -810,6 +810,55 @@ TEST_CASE("URI path parser")
             REQUIRE(parseQueryParams("stop-time=2023-05-20T18:30:00") == std::nullopt);
             REQUIRE(parseQueryParams("stop-time=20230520T18:30:00Z") == std::nullopt);
             REQUIRE(parseQueryParams("stop-time=2023-05-a0T18:30:00+05:30") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=name") == QueryParams{{"fields", fields::Expr{{{{"name"}}, {}}}}});
+            REQUIRE(parseQueryParams("fields=name;mod:oper-status") == QueryParams{{"fields", fields::Expr{{{{"name"}}, {}}, {{{"mod", "oper-status"}}, {}}}}});
+            REQUIRE(parseQueryParams("fields=a/b(c;d/e(f))") == QueryParams{{"fields", fields::Expr{
+                    {{{"a"}, {"b"}}, {
+                        {{{"c"}}, {}},
+                        {{{"d"}, {"e"}}, {{{{"f"}}, {}}}},
+                    }}}}}});
+            REQUIRE(parseQueryParams("fields=a(b);c&depth=1") == QueryParams{{"fields", fields::Expr{{{{"a"}}, {{{{"b"}}, {}}}}, {{{"c"}}, {}}}}, {"depth", 1u}});
+            REQUIRE(parseQueryParams("fields=") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=a;") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=a()") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=a(b") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=a/") == std::nullopt);
+            REQUIRE(parseQueryParams("fields=a[1]") == std::nullopt);
+            REQUIRE(parseQueryParams("limit=10") == QueryParams{{"limit", 10u}});
+            REQUIRE(parseQueryParams("limit=unbounded") == QueryParams{{"limit", limit::Unbounded{}}});
+            REQUIRE(parseQueryParams("limit=0") == std::nullopt);
+            REQUIRE(parseQueryParams("limit=-1") == std::nullopt);
+            REQUIRE(parseQueryParams("offset=0") == QueryParams{{"offset", 0u}});
+            REQUIRE(parseQueryParams("offset=20&limit=10") == QueryParams{{"offset", 20u}, {"limit", 10u}});
+            REQUIRE(parseQueryParams("offset=") == std::nullopt);
+            REQUIRE(parseQueryParams("rousette-batch-size=50&rousette-batch-window=20") == QueryParams{{"rousette-batch-size", 50u}, {"rousette-batch-window", 20u}});
+            REQUIRE(parseQueryParams("rousette-batch-size=0") == std::nullopt);
+            REQUIRE(parseQueryParams("rousette-batch-window=") == std::nullopt);
+            REQUIRE(parseQueryParams("rousette-max-rate=1") == QueryParams{{"rousette-max-rate", 1u}});
+            REQUIRE(parseQueryParams("rousette-max-rate=0") == std::nullopt);
+            REQUIRE(parseQueryParams("direction=forwards") == QueryParams{{"direction", direction::Forwards{}}});
+            REQUIRE(parseQueryParams("direction=backwards") == QueryParams{{"direction", direction::Backwards{}}});
+            REQUIRE(parseQueryParams("direction=sideways") == std::nullopt);
+            REQUIRE(parseQueryParams("sort-by=name") == QueryParams{{"sort-by", sortBy::Path{rousette::restconf::ApiIdentifier{"name"}}}});
+            REQUIRE(parseQueryParams("sort-by=example:stats/joined") == QueryParams{{"sort-by", sortBy::Path{{"example", "stats"}, rousette::restconf::ApiIdentifier{"joined"}}}});
+            REQUIRE(parseQueryParams("sort-by=.") == QueryParams{{"sort-by", sortBy::Self{}}});
+            REQUIRE(parseQueryParams("sort-by=") == std::nullopt);
+            REQUIRE(parseQueryParams("sort-by=a[1]") == std::nullopt);
+            REQUIRE(parseQueryParams("sort-by=a//b") == std::nullopt);
+            REQUIRE(parseQueryParams("sort-by=../a") == std::nullopt);
+            REQUIRE(parseQueryParams("where=name='libyang'") == QueryParams{{"where", "name='libyang'"s}});
+            REQUIRE(parseQueryParams("where=choice1%3D'a%26b'&limit=1") == QueryParams{{"where", "choice1='a&b'"s}, {"limit", 1u}});
+            REQUIRE(parseQueryParams("where=") == std::nullopt);
+            REQUIRE(parseQueryParams("xpath=/example:tlc/list%5Bname=%27a%26b%27%5D&period=1000") == QueryParams{{"xpath", "/example:tlc/list[name='a&b']"s}, {"period", 1000u}});
+            REQUIRE(parseQueryParams("xpath=") == std::nullopt);
+            REQUIRE(parseQueryParams("period=0") == std::nullopt);
+            REQUIRE(parseQueryParams("period=1s") == std::nullopt);
+            REQUIRE(parseQueryParams("datastore=ietf-datastores:running") == QueryParams{{"datastore", "ietf-datastores:running"s}});
+            REQUIRE(parseQueryParams("modules=a") == QueryParams{{"modules", modules::Names{"a"}}});
+            REQUIRE(parseQueryParams("modules=czechlight-roadm-device,czechlight-inline-amp&rousette-max-rate=5") == QueryParams{{"modules", modules::Names{"czechlight-roadm-device", "czechlight-inline-amp"}}, {"rousette-max-rate", 5u}});
+            REQUIRE(parseQueryParams("modules=") == std::nullopt);
+            REQUIRE(parseQueryParams("modules=a,") == std::nullopt);
+            REQUIRE(parseQueryParams("modules=a,,b") == std::nullopt);
         }
 
         SECTION("Full requests with validation")
@@ -928,6 +977,19 @@ TEST_CASE("URI path parser")
                                        rousette::restconf::ErrorResponse);
             }
 
+            SECTION("rousette-filter")
+            {
+                auto resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc", "rousette-filter=/example:tlc/list[name='a']");
+                REQUIRE(resp.queryParams == QueryParams({{"rousette-filter", "/example:tlc/list[name='a']"s}}));
+
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "PUT", "/restconf/data/example:tlc", "rousette-filter=/example:tlc"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'rousette-filter' can be used only with GET and HEAD methods").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "rousette-filter=/example:tlc"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'rousette-filter' can't be used with streams").c_str(),
+                                       rousette::restconf::ErrorResponse);
+            }
+
             SECTION("start-time")
             {
                 auto resp = asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "start-time=2024-01-01T01:01:01Z");
@@ -938,6 +1000,29 @@ TEST_CASE("URI path parser")
                                        rousette::restconf::ErrorResponse);
             }
 
+            SECTION("batching")
+            {
+                auto resp = asRestconfStreamRequest("GET", "/streams/NETCONF/JSON", "rousette-batch-size=100&rousette-batch-window=50");
+                REQUIRE(resp.queryParams == QueryParams({{"rousette-batch-size", 100u}, {"rousette-batch-window", 50u}}));
+
+                resp = asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "rousette-max-rate=5");
+                REQUIRE(resp.queryParams == QueryParams({{"rousette-max-rate", 5u}}));
+
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:ordered-lists", "rousette-batch-size=10"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'rousette-batch-size' can be used only with streams").c_str(),
+                                       rousette::restconf::ErrorResponse);
+            }
+
+            SECTION("telemetry parameters")
+            {
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc", "xpath=/example:tlc"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'xpath' can be used only with telemetry").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "period=100"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'period' can't be used with streams").c_str(),
+                                       rousette::restconf::ErrorResponse);
+            }
+
             SECTION("stop-time")
             {
                 auto resp = asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "stop-time=2024-01-01T01:01:01Z");
@@ -948,6 +1033,94 @@ TEST_CASE("URI path parser")
                                        rousette::restconf::ErrorResponse);
             }
 
+            SECTION("fields")
+            {
+                using rousette::restconf::fieldsToXPath;
+
+                auto resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc", "fields=list(name;collection)");
+                REQUIRE(resp.queryParams == QueryParams({{"fields", fields::Expr{{{{"list"}}, {{{{"name"}}, {}}, {{{"collection"}}, {}}}}}}}));
+                REQUIRE(fieldsToXPath(resp.path, std::get<fields::Expr>(resp.queryParams.begin()->second)) == "/example:tlc/list/name | /example:tlc/list/collection");
+
+                resp = asRestconfRequest(ctx, "GET", "/restconf/data", "fields=example:tlc/list/name;example:a(example-augment:b)");
+                REQUIRE(fieldsToXPath(resp.path, std::get<fields::Expr>(resp.queryParams.begin()->second)) == "/example:tlc/list/name | /example:a/example-augment:b");
+
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "PUT", "/restconf/data/example:tlc", "fields=list"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'fields' can be used only with GET and HEAD methods").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "fields=list"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'fields' can't be used with streams").c_str(),
+                                       rousette::restconf::ErrorResponse);
+            }
+
+            SECTION("list pagination")
+            {
+                auto resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "limit=2&offset=1&direction=backwards&sort-by=choice1&where=name!='a'");
+                REQUIRE(resp.path == "/example:tlc/list");
+                REQUIRE(resp.queryParams == QueryParams({
+                            {"limit", 2u},
+                            {"offset", 1u},
+                            {"direction", direction::Backwards{}},
+                            {"sort-by", sortBy::Path{rousette::restconf::ApiIdentifier{"choice1"}}},
+                            {"where", "name!='a'"s},
+                        }));
+
+                resp = asRestconfRequest(ctx, "HEAD", "/restconf/data/example:top-level-list", "limit=unbounded");
+                REQUIRE(resp.path == "/example:top-level-list");
+
+                resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:top-level-leaf-list", "offset=1");
+                REQUIRE(resp.path == "/example:top-level-leaf-list");
+
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:top-level-list", ""),
+                                       serializeErrorResponse(400, "application", "operation-failed", "List '/example:top-level-list' requires 1 keys").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list=a", "limit=1"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "List pagination query parameters can be used only with a list or a leaf-list target").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc", "limit=1"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "List pagination query parameters can be used only with a list or a leaf-list target").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data", "offset=1"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "List pagination query parameters can be used only with a list or a leaf-list target").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "PUT", "/restconf/data/example:top-level-list=a", "limit=1"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'limit' can be used only with GET and HEAD methods").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "where=a"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'where' can't be used with streams").c_str(),
+                                       rousette::restconf::ErrorResponse);
+
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "sort-by=nested"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'sort-by' does not refer to a leaf of the list entries").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "sort-by=nonexistent"),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'sort-by' does not refer to a leaf of the list entries").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "sort-by=."),
+                                       serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'sort-by' can be '.' only for a leaf-list").c_str(),
+                                       rousette::restconf::ErrorResponse);
+                resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:top-level-leaf-list", "sort-by=.");
+                REQUIRE(resp.queryParams == QueryParams({{"sort-by", sortBy::Self{}}}));
+
+                // the predicate is enclosed in brackets after the list, it must not escape them
+                resp = asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "where=name='a]' or (collection=1 and nested[first='%7C'])");
+                REQUIRE(resp.queryParams == QueryParams({{"where", "name='a]' or (collection=1 and nested[first='|'])"s}}));
+                for (const auto& where : {
+                         "true()]%7C/other-module:*[true()",
+                         "true()]",
+                         "name='a'%7C/example:a",
+                         "(name='a'",
+                         "name='a')",
+                         "name='a",
+                         "nested[first='a')]",
+                         "name==",
+                     }) {
+                    CAPTURE(where);
+                    REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc/list", "where="s + where),
+                                           serializeErrorResponse(400, "protocol", "invalid-value", "Query parameter 'where' is not a valid XPath predicate").c_str(),
+                                           rousette::restconf::ErrorResponse);
+                }
+            }
+
             REQUIRE_THROWS_WITH_AS(asRestconfRequest(ctx, "GET", "/restconf/data/example:tlc", "hello=world"),
                                    serializeErrorResponse(400, "protocol", "invalid-value", "Query parameters syntax error").c_str(),
                                    rousette::restconf::ErrorResponse);
@@ -960,13 +1133,22 @@ TEST_CASE("URI path parser")
         using rousette::restconf::RestconfStreamRequest;
 
         {
-            auto [type, queryParams] = asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "");
+            auto [name, type, queryParams] = asRestconfStreamRequest("GET", "/streams/NETCONF/XML", "");
+            REQUIRE(name == "NETCONF");
             REQUIRE(type == RestconfStreamRequest::Type::NetconfNotificationXML);
             REQUIRE(queryParams.empty());
         }
 
         {
-            auto [type, queryParams] = asRestconfStreamRequest("GET", "/streams/NETCONF/JSON", "");
+            auto [name, type, queryParams] = asRestconfStreamRequest("GET", "/streams/NETCONF/JSON", "");
+            REQUIRE(name == "NETCONF");
+            REQUIRE(type == RestconfStreamRequest::Type::NetconfNotificationJSON);
+            REQUIRE(queryParams.empty());
+        }
+
+        {
+            auto [name, type, queryParams] = asRestconfStreamRequest("GET", "/streams/example-notif/JSON", "");
+            REQUIRE(name == "example-notif");
             REQUIRE(type == RestconfStreamRequest::Type::NetconfNotificationJSON);
             REQUIRE(queryParams.empty());
         }
@@ -983,6 +1165,12 @@ TEST_CASE("URI path parser")
         REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XM", ""),
                 serializeErrorResponse(404, "application", "invalid-value", "Invalid stream").c_str(),
                 rousette::restconf::ErrorResponse);
+        REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams//XML", ""),
+                serializeErrorResponse(404, "application", "invalid-value", "Invalid stream").c_str(),
+                rousette::restconf::ErrorResponse);
+        REQUIRE_THROWS_WITH_AS(asRestconfStreamRequest("GET", "/streams/NETCONF/XML/JSON", ""),
+                serializeErrorResponse(404, "application", "invalid-value", "Invalid stream").c_str(),
+                rousette::restconf::ErrorResponse);
 
 
         for (const auto& httpMethod : {"OPTIONS", "PATCH", "DELETE", "POST", "PUT"}) {
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2024 CESNET, https://photonics.cesnet.cz/
+ *
+ */
+
+#include "trompeloeil_doctest.h"
+#include <libyang-cpp/Context.hpp>
+#include "restconf/Exceptions.h"
+#include "restconf/YangPush.h"
+#include "tests/configure.cmake.h"
+
+using namespace std::string_literals;
+
+TEST_CASE("periodic subscription requests")
+{
+    using rousette::restconf::asPeriodicSubscription;
+
+    auto ctx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+    ctx.loadModule("example", std::nullopt, {"f1"});
+
+    SECTION("valid")
+    {
+        auto key = asPeriodicSubscription(ctx, "xpath=%2Fexample%3Atlc%2Flist%5Bname%3D%27a%27%5D&period=500");
+        REQUIRE(key.xpath == "/example:tlc/list[name='a']");
+        REQUIRE(key.period == std::chrono::milliseconds{500});
+        REQUIRE(key.datastore == sysrepo::Datastore::Operational);
+        REQUIRE(!key.user);
+
+        key = asPeriodicSubscription(ctx, "period=10&datastore=ietf-datastores:running&xpath=/example:top-level-leaf");
+        REQUIRE(key.xpath == "/example:top-level-leaf");
+        REQUIRE(key.period == std::chrono::milliseconds{10});
+        REQUIRE(key.datastore == sysrepo::Datastore::Running);
+    }
+
+    SECTION("invalid")
+    {
+        std::string queryString;
+        int expectedCode;
+        std::string expectedMessage;
+
+        DOCTEST_SUBCASE("syntax")
+        {
+            queryString = "xpath=/example:tlc&period=100&";
+            expectedCode = 400;
+            expectedMessage = "Query parameters syntax error";
+        }
+        DOCTEST_SUBCASE("repeated period")
+        {
+            queryString = "xpath=/example:tlc&period=100&period=200";
+            expectedCode = 400;
+            expectedMessage = "Query parameter 'period' already specified";
+        }
+        DOCTEST_SUBCASE("missing period")
+        {
+            queryString = "xpath=/example:tlc";
+            expectedCode = 400;
+            expectedMessage = R"(Query parameters "xpath" and "period" are required)";
+        }
+        DOCTEST_SUBCASE("bad period")
+        {
+            queryString = "xpath=/example:tlc&period=1s";
+            expectedCode = 400;
+            expectedMessage = "Query parameters syntax error";
+        }
+        DOCTEST_SUBCASE("short period")
+        {
+            queryString = "xpath=/example:tlc&period=1";
+            expectedCode = 400;
+            expectedMessage = "The period must be at least 10 ms";
+        }
+        DOCTEST_SUBCASE("unknown datastore")
+        {
+            queryString = "xpath=/example:tlc&period=100&datastore=ietf-datastores:foo";
+            expectedCode = 400;
+            expectedMessage = "Unsupported datastore ietf-datastores:foo";
+        }
+        DOCTEST_SUBCASE("unknown parameter")
+        {
+            queryString = "xpath=/example:tlc&period=100&depth=1";
+            expectedCode = 400;
+            expectedMessage = R"(Unsupported query parameter "depth")";
+        }
+        DOCTEST_SUBCASE("nothing selected")
+        {
+            queryString = "xpath=/example:nonexistent&period=100";
+            expectedCode = 400;
+            expectedMessage = R"(XPath "/example:nonexistent" does not select any data.)";
+        }
+
+        try {
+            asPeriodicSubscription(ctx, queryString);
+            FAIL("expected an exception");
+        } catch (const rousette::restconf::ErrorResponse& e) {
+            REQUIRE(e.code == expectedCode);
+            REQUIRE(e.errorMessage == expectedMessage);
+        }
+    }
+}
+
+TEST_CASE("on-change subscription requests")
+{
+    using rousette::restconf::asOnChangeSubscription;
+
+    auto ctx = libyang::Context{std::filesystem::path{CMAKE_CURRENT_SOURCE_DIR} / "tests" / "yang"};
+    ctx.loadModule("example", std::nullopt, {"f1"});
+    ctx.loadModule("example-augment");
+
+    SECTION("valid")
+    {
+        auto [key, modules] = asOnChangeSubscription(ctx, "xpath=/example:tlc/list/choice1&datastore=ietf-datastores:running");
+        REQUIRE(key.xpath == "/example:tlc/list/choice1");
+        REQUIRE(key.datastore == sysrepo::Datastore::Running);
+        REQUIRE(modules == std::set<std::string>{"example"});
+
+        std::tie(key, modules) = asOnChangeSubscription(ctx, "xpath=/example:top-level-leaf%20%7C%20/example:tlc");
+        REQUIRE(key.datastore == sysrepo::Datastore::Operational);
+        REQUIRE(modules == std::set<std::string>{"example"});
+
+        // sysrepo stores the augmenting nodes along with the data of the augmented module
+        std::tie(key, modules) = asOnChangeSubscription(ctx, "xpath=/example:a/example-augment:b/c");
+        REQUIRE(modules == std::set<std::string>{"example"});
+    }
+
+    SECTION("invalid")
+    {
+        std::string queryString;
+        std::string expectedMessage;
+
+        DOCTEST_SUBCASE("missing XPath")
+        {
+            queryString = "datastore=ietf-datastores:running";
+            expectedMessage = R"(Query parameter "xpath" is required)";
+        }
+        DOCTEST_SUBCASE("factory-default")
+        {
+            queryString = "xpath=/example:tlc&datastore=ietf-datastores:factory-default";
+            expectedMessage = "The factory-default datastore never changes";
+        }
+        DOCTEST_SUBCASE("period")
+        {
+            queryString = "xpath=/example:tlc&period=100";
+            expectedMessage = R"(Unsupported query parameter "period")";
+        }
+        DOCTEST_SUBCASE("nothing selected")
+        {
+            queryString = "xpath=/example:tlc/";
+            expectedMessage = R"(XPath "/example:tlc/" does not select any data.)";
+        }
+
+        try {
+            asOnChangeSubscription(ctx, queryString);
+            FAIL("expected an exception");
+        } catch (const rousette::restconf::ErrorResponse& e) {
+            REQUIRE(e.code == 400);
+            REQUIRE(e.errorMessage == expectedMessage);
+        }
+    }
+}
+
+TEST_CASE("optics telemetry requests")
+{
+    using rousette::restconf::asOpticsTelemetryRequest;
+    const std::set<std::string> available{"czechlight-inline-amp", "czechlight-roadm-device"};
+
+    auto request = asOpticsTelemetryRequest(available, "");
+    REQUIRE(!request.maxRate);
+    REQUIRE(request.modules == available);
+
+    request = asOpticsTelemetryRequest(available, "rousette-max-rate=2");
+    REQUIRE(request.maxRate == 2u);
+    REQUIRE(request.modules == available);
+
+    request = asOpticsTelemetryRequest(available, "modules=czechlight-roadm-device");
+    REQUIRE(!request.maxRate);
+    REQUIRE(request.modules == std::set<std::string>{"czechlight-roadm-device"});
+
+    request = asOpticsTelemetryRequest(available, "modules=czechlight-roadm-device,czechlight-inline-amp&rousette-max-rate=5");
+    REQUIRE(request.maxRate == 5u);
+    REQUIRE(request.modules == available);
+
+    for (const auto& [queryString, expectedMessage] : {
+             std::pair<std::string, std::string>{"rousette-max-rate=0", "Query parameters syntax error"},
+             {"rousette-max-rate=fast", "Query parameters syntax error"},
+             {"xpath=/example:tlc", R"(Unsupported query parameter "xpath")"},
+             {"modules=czechlight-bidi-amp", R"(Module "czechlight-bidi-amp" is not available for optics telemetry)"},
+             {"modules=czechlight-roadm-device,", "Query parameters syntax error"},
+             {"modules=", "Query parameters syntax error"},
+         }) {
+        CAPTURE(queryString);
+        try {
+            asOpticsTelemetryRequest(available, queryString);
+            FAIL("expected an exception");
+        } catch (const rousette::restconf::ErrorResponse& e) {
+            REQUIRE(e.code == 400);
+            REQUIRE(e.errorMessage == expectedMessage);
+        }
+    }
+}